@@ -16,6 +16,7 @@ import com.google.android.things.pio.PeripheralManager;
 import com.google.android.things.pio.UartDevice;
 import com.google.android.things.pio.UartDeviceCallback;
 
+import java.io.ByteArrayOutputStream;
 import java.io.IOException;
 import java.io.UnsupportedEncodingException;
 import java.nio.charset.StandardCharsets;
@@ -30,6 +31,17 @@ public class AsyncHandlerThread extends HandlerThread {
     private UartDevice mDevice;         // async device
     private Handler mHandler;
     private int sequence;               // sequence number for hello/ack
+    private int relExpected;            // next "rel:" record expected (reliable mode)
+    private int relAcked;               // last "rack:" sent
+    private int relWindow = 8;          // Arduino's window (from "reliable:")
+    private int relAckDelay = 125;      // msec an ack may wait: half the Arduino's timeout
+    private boolean relAckPending;      // an ack is due after relAckDelay
+    private boolean crcSeen;            // Arduino is sending CRC trailers ("crc: on")
+    private SampleRecord.Decoder decoder = new SampleRecord.Decoder();    // "binary: on" records
+    private byte[] record = new byte[SampleRecord.LENGTH];    // record being received
+    private int recordLength;           // bytes of it received so far
+    private ByteArrayOutputStream line = new ByteArrayOutputStream();    // line being received
+    private static final int MAX_LINE = 200;    // longer lines are truncated
 
     private String TAG = AsyncHandlerThread.class.getSimpleName();
 
@@ -163,37 +175,152 @@ public class AsyncHandlerThread extends HandlerThread {
 
 
 
-    /* readUartBuffer - read data from uart buffer.
+    /* readUartBuffer - read data from uart buffer, and split it into
+     * lines of text and binary sample records (see SampleRecord).  UART
+     * reads do not line up with either, so a partial line or record is
+     * kept until the rest arrives.  A byte with the top bit set starts a
+     * record (text never has it set), wherever it falls.
      */
 
     private void readUartBuffer(UartDevice uart) throws IOException {
 
         final int maxCount = 100;        // max data to read at once
         byte[] buffer = new byte[maxCount];    // data buffer
-        double temp = 0.0;              // temp read over async interface
 
         int count;
         while ((count = uart.read(buffer, buffer.length)) > 0) {
-            String string = new String(buffer, 0, count, StandardCharsets.UTF_8);
-            String tokens[] = string.split("[ ]+");
-            if (tokens.length >= 2) {
+            for (int i = 0; i < count; i++) {
+                byte b = buffer[i];
+                if (recordLength > 0) {                     // rest of a record
+                    record[recordLength++] = b;
+                    if (recordLength == SampleRecord.LENGTH) {
+                        SampleRecord r = decoder.decode(record, 0);
+                        if ((r != null) && (r.type == SampleRecord.TEMP)) mActivity.setAsyncTemp(r.value);
+                        recordLength = 0;
+                    }
+                } else if ((b & SampleRecord.MARK) != 0) {  // start of a record
+                    record[recordLength++] = b;
+                } else if (b == '\n') {                     // end of a line
+                    processLine(new String(line.toByteArray(), StandardCharsets.UTF_8));
+                    line.reset();
+                } else if ((b != '\r') && (line.size() < MAX_LINE)) {
+                    line.write(b);
+                }
+            }
+        }
+    }
+
+
+
+    /* processLine - process one line of text from the Arduino.
+     */
+
+    private void processLine(String string) {
+
+        double temp = 0.0;              // temp read over async interface
+
+        /* Check and remove a CRC trailer (see Crc16). */
+
+        crcSeen = string.indexOf('*') >= 0;
+        if (crcSeen) {
+            String body = Crc16.check(string.trim());
+            if (body == null) {
+                Log.d(TAG, "Rx async CRC error: " + string);
+                return;
+            }
+            string = body;
+        }
+
+        String tokens[] = string.split("[ ]+");
+        if (tokens.length >= 2) {
+
+            /* Process "temp: <temp>" command. */
+
+            if (tokens[0].equalsIgnoreCase("temp:")) {
+                try
+                {
+                    temp = Double.valueOf(tokens[1]);
+                    mActivity.setAsyncTemp(temp);
+                }
+                catch (NumberFormatException nfe)
+                {
+                    mActivity.setAsyncTemp(-3.0);
+                }
+            }
 
-                /* Process "temp: <temp>" command. */
+            /* Process "rel: <seq> <time> <temp>" record (reliable mode).
+             * Records are accepted in order only, and acknowledged
+             * cumulatively with "rack: <next expected>": at once when
+             * half the window is unacknowledged, or a record is out of
+             * order (so a loss is resent without waiting), otherwise
+             * within relAckDelay, before the Arduino times out. */
 
-                if (tokens[0].equalsIgnoreCase("temp:")) {
-                    try
-                    {
-                        temp = Double.valueOf(tokens[1]);
-                        mActivity.setAsyncTemp(temp);
+            if (tokens[0].equalsIgnoreCase("rel:") && (tokens.length >= 4)) {
+                try {
+                    int seq = Integer.parseInt(tokens[1]);
+                    boolean inOrder = (seq == relExpected);
+                    if (inOrder) {
+                        relExpected = (relExpected + 1) & 0xffff;
+                        mActivity.setAsyncTemp(Double.valueOf(tokens[3]));
                     }
-                    catch (NumberFormatException nfe)
-                    {
-                        mActivity.setAsyncTemp(-3.0);
+                    int unacked = (relExpected - relAcked) & 0xffff;
+                    if (!inOrder || (unacked >= Math.max(1, relWindow / 2))) {
+                        sendRack();
+                    } else if (!relAckPending) {
+                        relAckPending = true;
+                        mHandler.postDelayed(new Runnable() {
+                            public void run() {
+                                if (relAckPending) sendRack();
+                            }
+                        }, relAckDelay);
                     }
+                } catch (NumberFormatException nfe) {
+                    Log.d(TAG, "Bad rel: record: " + string);
+                }
+            }
+
+            /* Process "binary: <if> <on|off>" reply: the next record is
+             * a TIME record. */
+
+            if (tokens[0].equalsIgnoreCase("binary:")) decoder.reset();
+
+            /* Process "reliable: <on|off> <window> <rto> <next seq> <unacked> ..."
+             * reply: expect the oldest unacknowledged record next ("on"
+             * restarts the sequence). */
+
+            if (tokens[0].equalsIgnoreCase("reliable:") && (tokens.length >= 6)) {
+                try {
+                    relWindow = Integer.parseInt(tokens[2]);
+                    relAckDelay = Math.max(1, Integer.parseInt(tokens[3]) / 2);
+                    relExpected = (Integer.parseInt(tokens[4])
+                            - Integer.parseInt(tokens[5])) & 0xffff;
+                } catch (NumberFormatException nfe) {
+                    relExpected = 0;
                 }
+                relAcked = relExpected;
+                relAckPending = false;
             }
-            Log.d(TAG, "Rx async: " + string.replace("\n", ""));
         }
+        Log.d(TAG, "Rx async: " + string);
+    }
+
+
+
+    /* sendRack - acknowledge every "rel:" record before relExpected.
+     */
+
+    private void sendRack() {
+
+        String rack = String.format("rack: %d", relExpected);
+        if (crcSeen) rack = Crc16.append(rack);
+        byte[] b = (rack + "\r\n").getBytes(StandardCharsets.UTF_8);
+        try {
+            mDevice.write(b, b.length);
+        } catch (IOException e) {
+            Log.d(TAG, "Unable to send rack: " + mAsyncDevice, e);
+        }
+        relAcked = relExpected;
+        relAckPending = false;
     }
 
 }
@@ -0,0 +1,76 @@
+/* Crc16 - CRC-16 frame trailers, as used by the Arduino board.
+ *
+ * After "crc: on", every line on an interface, in both directions, ends
+ * with '*' and the CRC of the bytes before it as 4 hex digits, e.g.:
+ *
+ *     temp: 25.4*5E09
+ *
+ * The CRC is CRC-16/CCITT-FALSE (polynomial 0x1021, initial value
+ * 0xffff, not reflected), as computed by tjs_crc.h.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+package com.salo.android.arduinointegration;
+
+import java.nio.charset.StandardCharsets;
+
+
+public class Crc16 {
+
+    private static final int[] TABLE = new int[256];
+
+    static {
+        for (int i = 0; i < 256; i++) {
+            int crc = i << 8;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = ((crc & 0x8000) != 0) ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+            TABLE[i] = crc & 0xffff;
+        }
+    }
+
+
+
+    /* compute - return the CRC of len bytes of b, from off.
+     */
+
+    public static int compute(byte[] b, int off, int len) {
+        int crc = 0xffff;
+        for (int i = off; i < off + len; i++) {
+            crc = ((crc << 8) ^ TABLE[((crc >> 8) ^ b[i]) & 0xff]) & 0xffff;
+        }
+        return crc;
+    }
+
+
+
+    /* append - return line with its trailer.
+     */
+
+    public static String append(String line) {
+        byte[] b = line.getBytes(StandardCharsets.UTF_8);
+        return String.format("%s*%04X", line, compute(b, 0, b.length));
+    }
+
+
+
+    /* check - return line without its trailer, or null if the trailer is
+     * missing or wrong.
+     */
+
+    public static String check(String line) {
+        int star = line.lastIndexOf('*');
+        if ((star < 0) || (line.length() != star + 5)) return null;
+        String body = line.substring(0, star);
+        byte[] b = body.getBytes(StandardCharsets.UTF_8);
+        try {
+            if (Integer.parseInt(line.substring(star + 1), 16) != compute(b, 0, b.length)) {
+                return null;
+            }
+        } catch (NumberFormatException e) {
+            return null;
+        }
+        return body;
+    }
+}
@@ -0,0 +1,79 @@
+/* DeltaDecoder - decode a block of compressed sample history received
+ * from the Arduino board.
+ *
+ * The Arduino answers "history: <block>" with a line of the form:
+ *
+ *     hist: <seq> <time> <period> <key> <count> <hex deltas>
+ *
+ * The first sample is <key>.  Each following sample is encoded as a
+ * zig-zag delta from the previous sample, packed as a little-endian
+ * base-128 varint (see tjs_delta.c).  Values are in 0.1 degrees C, and
+ * sample i was taken at <time> + i * <period> msec (Arduino clock).
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+package com.salo.android.arduinointegration;
+
+
+public class DeltaDecoder {
+
+    public final int seq;               // sequence number of first sample
+    public final long time;             // Arduino msec clock of first sample
+    public final int period;            // msec between samples
+    public final double[] values;       // samples, in degrees C
+
+
+    private DeltaDecoder(int seq, long time, int period, double[] values) {
+        this.seq = seq;
+        this.time = time;
+        this.period = period;
+        this.values = values;
+    }
+
+
+
+    /* parse - decode a "hist:" line.  Returns null if the line is not a
+     * well-formed "hist:" line.
+     */
+
+    public static DeltaDecoder parse(String line) {
+
+        String[] tokens = line.trim().split("\\s+");
+        if ((tokens.length < 6) || !tokens[0].equals("hist:")) return null;
+
+        try {
+            int seq = Integer.parseInt(tokens[1]);
+            long time = Long.parseLong(tokens[2]);
+            int period = Integer.parseInt(tokens[3]);
+            int key = Integer.parseInt(tokens[4]);
+            int count = Integer.parseInt(tokens[5]);
+            String hex = (tokens.length > 6) ? tokens[6] : "";
+
+            double[] values = new double[count];
+            short value = (short) key;
+            values[0] = value / 10.0;
+
+            int p = 0;
+            for (int i = 1; i < count; i++) {
+                int zigzag = 0;
+                int shift = 0;
+                int b;
+                do {
+                    if (p + 2 > hex.length() || shift > 14) return null;
+                    b = Integer.parseInt(hex.substring(p, p + 2), 16);
+                    p += 2;
+                    zigzag |= (b & 0x7f) << shift;
+                    shift += 7;
+                } while ((b & 0x80) != 0);
+                int delta = (zigzag >>> 1) ^ -(zigzag & 1);
+                value = (short) (value + delta);    // 16-bit wrap, as on the Arduino
+                values[i] = value / 10.0;
+            }
+            return new DeltaDecoder(seq, time, period, values);
+
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+}
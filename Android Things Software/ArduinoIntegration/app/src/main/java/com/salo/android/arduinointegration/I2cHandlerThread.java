@@ -40,6 +40,10 @@ public class I2cHandlerThread extends HandlerThread {
     private int sequence;               // sequence number for hello/ack
     private byte recBuff[] = new byte[REC_BUFF_LENG];    // receive buffer
     private int recBuffp;               // receive buffer pointer
+    private boolean useCrc = true;      // send and check CRC trailers (see Crc16)
+    private int crcErrors;              // replies with a bad or missing trailer
+    private boolean useBinary = true;   // ask for binary sample records (see SampleRecord)
+    private SampleRecord.Decoder decoder = new SampleRecord.Decoder();
 
 
     private static final String TAG = I2cHandlerThread.class.getSimpleName();
@@ -106,11 +110,42 @@ public class I2cHandlerThread extends HandlerThread {
 
                 case IDLE:
 
+                    /* Turn on CRC trailers.  If they are already on, the
+                     * command has no trailer, and is dropped. */
+
+                    if (useCrc) {
+                        try {
+                            byte[] data = "crc: on\n".getBytes("UTF-8");
+                            mDevice.write(data, data.length);
+                            sleep(150);
+                        } catch (IOException e) {
+                            Log.d(TAG, "IDLE: write of \"crc: on\" failed.");
+                        } catch (InterruptedException e) {
+                            Log.d(TAG, "IDLE: sleep interrupted.");
+                        }
+                    }
+
+                    /* Ask for binary sample records, which start with a
+                     * TIME record. */
+
+                    if (useBinary) {
+                        try {
+                            byte[] data = (frame("binary: on") + "\n").getBytes("UTF-8");
+                            mDevice.write(data, data.length);
+                            decoder.reset();
+                            sleep(150);
+                        } catch (IOException e) {
+                            Log.d(TAG, "IDLE: write of \"binary: on\" failed.");
+                        } catch (InterruptedException e) {
+                            Log.d(TAG, "IDLE: sleep interrupted.");
+                        }
+                    }
+
                     /* Send "hello <seq>" messages to slave. */
 
                     try {
-                        helloSequence = String.format("hello: %05d\n", sequence++);
-                        byte[] data = helloSequence.getBytes("UTF-8");
+                        helloSequence = String.format("hello: %05d", sequence++);
+                        byte[] data = (frame(helloSequence) + "\n").getBytes("UTF-8");
                         mDevice.write(data, data.length);
                         Log.d(TAG, "Tx: " + helloSequence);
                     } catch (IOException e) {
@@ -183,6 +218,7 @@ public class I2cHandlerThread extends HandlerThread {
                     }
 
                     Log.d(TAG, "Rx: " + recString);
+                    recString = unframe(recString);
 
                     /* Check for a comment string. */
 
@@ -235,7 +271,7 @@ public class I2cHandlerThread extends HandlerThread {
                 case LINK_ESTABLISHED:
 
                     try {
-                        byte[] data = "send: temp\n".getBytes("UTF-8");
+                        byte[] data = (frame("send: temp") + "\n").getBytes("UTF-8");
                         mDevice.write(data, data.length);
                         Log.d(TAG, "Tx: " + "send: temp");
                     } catch (IOException e) {
@@ -269,6 +305,21 @@ public class I2cHandlerThread extends HandlerThread {
                         break;
                     }
 
+                    /* Binary mode: decode the records, before the hack below
+                     * clears the top bit of the first one. */
+
+                    if (useBinary && SampleRecord.isRecord(recBuff[0])) {
+                        state = decodeRecords() ? LINK_ESTABLISHED : IDLE;
+
+                        try {           // wait before sending "send temp"
+                            sleep(5000);
+                        } catch (InterruptedException e) {
+                            Log.d(TAG, "SEND_SENT: sleep interrupted");
+                        }
+
+                        break;
+                    }
+
                     /* Check to see if received message is an ack. */
 
                     recString = "yyy";
@@ -303,6 +354,7 @@ public class I2cHandlerThread extends HandlerThread {
 
 
                     Log.d(TAG, "Rx: " + recString);
+                    recString = unframe(recString);
 
                     /* Check for a comment string. */
 
@@ -326,6 +378,9 @@ public class I2cHandlerThread extends HandlerThread {
                         Log.d(TAG, "temp: received " + tokens[1]);
                         activity.setI2CTemp(Double.valueOf(tokens[1]));
                         state = LINK_ESTABLISHED;
+                    } else if (tokens[0].equals("same:")) {
+                        Log.d(TAG, "same: temp unchanged");    // deadband mode: keep last value
+                        state = LINK_ESTABLISHED;
                     } else {
                         Log.d(TAG, "Unexpected response to \"send temp\"");
                         state = IDLE;
@@ -378,6 +433,7 @@ public class I2cHandlerThread extends HandlerThread {
                     }
 
                     Log.d(TAG, "Rx: " + recString);
+                    recString = unframe(recString);
 
                     tokens = recString.split("\\s+");
                     for (int i = 0; i < tokens.length; i++) {
@@ -396,4 +452,56 @@ public class I2cHandlerThread extends HandlerThread {
 
         }
     }
+
+
+
+    /* frame - return a command to send, with its CRC trailer if CRC
+     * trailers are in use.
+     */
+
+    private String frame(String command) {
+        return useCrc ? Crc16.append(command) : command;
+    }
+
+
+
+    /* unframe - return a received reply without its CRC trailer, if CRC
+     * trailers are in use, or "" (which matches no reply) if the trailer
+     * is missing or wrong.
+     */
+
+    private String unframe(String reply) {
+        if (!useCrc) return reply;
+        String body = Crc16.check(reply.trim());
+        if (body == null) {
+            crcErrors++;
+            Log.d(TAG, "CRC error (" + crcErrors + "): " + reply);
+            return "";
+        }
+        return body;
+    }
+
+
+
+    /* decodeRecords - decode the sample records in recBuff (see
+     * SampleRecord), and show the latest temperature.  Returns false if
+     * recBuff does not hold a TEMP record.
+     */
+
+    private boolean decodeRecords() {
+
+        boolean found = false;
+
+        for (int off = 0; off + SampleRecord.LENGTH <= recBuff.length; off += SampleRecord.LENGTH) {
+            SampleRecord r = decoder.decode(recBuff, off);
+            if (r == null) break;
+            if (r.type == SampleRecord.TEMP) {
+                Log.d(TAG, String.format("rec: seq %d time %d temp %.1f%s", r.seq, r.time,
+                        r.value, ((r.flags & SampleRecord.FLAG_SAME) != 0) ? " (same)" : ""));
+                activity.setI2CTemp(r.value);
+                found = true;
+            }
+        }
+        return found;
+    }
 }
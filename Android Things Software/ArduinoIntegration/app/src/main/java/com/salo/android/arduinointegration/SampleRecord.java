@@ -0,0 +1,108 @@
+/* SampleRecord - binary sample records received from the Arduino board.
+ *
+ * After "binary: on", readings arrive as 8-byte records instead of "temp:"
+ * text (see tjs_record.h, which this class mirrors).  Multi-byte fields
+ * are little-endian:
+ *
+ *     byte 0     MARK | (VERSION << 4) | type
+ *     byte 1     flags (FLAG_*)
+ *     bytes 2-3  seq: history sequence number of the sample
+ *     bytes 4-7  TEMP: msec since the previous record, then the value,
+ *                      in 0.1 degrees C
+ *                TIME: Arduino msec clock
+ *
+ * A TIME record sets the clock that the following TEMP records count
+ * from, so records on one interface must be decoded in order, by one
+ * Decoder.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+package com.salo.android.arduinointegration;
+
+
+public class SampleRecord {
+
+    public static final int MARK = 0x80;        // set in byte 0 of every record
+    public static final int VERSION = 1;        // layout version
+    public static final int LENGTH = 8;         // bytes per record
+
+    public static final int TEMP = 1;           // temperature sample
+    public static final int TIME = 2;           // absolute time
+
+    public static final int FLAG_SAME = 0x01;   // deadband: unchanged since last sent
+
+    public final int type;              // TEMP or TIME
+    public final int flags;             // FLAG_*
+    public final int seq;               // history sequence number
+    public final long time;             // Arduino msec clock of the sample
+    public final double value;          // degrees C (TEMP only)
+
+
+    private SampleRecord(int type, int flags, int seq, long time, double value) {
+        this.type = type;
+        this.flags = flags;
+        this.seq = seq;
+        this.time = time;
+        this.value = value;
+    }
+
+
+
+    /* isRecord - return true if b, the first byte of a reply, starts a
+     * record.  The top bit (MARK) is not checked, as the I2C read may not
+     * deliver it (see I2cHandlerThread); the version field is enough,
+     * since no text reply starts with a control character.
+     */
+
+    public static boolean isRecord(byte b) {
+        int type = b & 0x0f;
+        return ((b & 0x70) == (VERSION << 4)) && ((type == TEMP) || (type == TIME));
+    }
+
+
+
+    /* Decoder - decodes the records from one interface, in order.
+     */
+
+    public static class Decoder {
+
+        private long time;              // time of the last record
+        private boolean timeValid;      // a TIME record has been decoded
+
+
+        /* decode - decode the record at b[off].  Returns null if it is not
+         * a record, or is a TEMP record before any TIME record.
+         */
+
+        public SampleRecord decode(byte[] b, int off) {
+
+            if ((off + LENGTH > b.length) || !isRecord(b[off])) return null;
+
+            int type = b[off] & 0x0f;
+            int flags = b[off + 1] & 0xff;
+            int seq = (b[off + 2] & 0xff) | ((b[off + 3] & 0xff) << 8);
+            int a = (b[off + 4] & 0xff) | ((b[off + 5] & 0xff) << 8);
+            int c = (b[off + 6] & 0xff) | ((b[off + 7] & 0xff) << 8);
+
+            if (type == TIME) {
+                time = ((long) c << 16) | a;
+                timeValid = true;
+                return new SampleRecord(type, flags, seq, time, 0.0);
+            }
+            if (!timeValid) return null;
+            time = (time + a) & 0xffffffffL;    // 32-bit wrap, as on the Arduino
+            return new SampleRecord(type, flags, seq, time, (short) c / 10.0);
+        }
+
+
+
+        /* reset - forget the time, e.g., after "binary: on", which makes
+         * the Arduino start with a TIME record.
+         */
+
+        public void reset() {
+            timeValid = false;
+        }
+    }
+}
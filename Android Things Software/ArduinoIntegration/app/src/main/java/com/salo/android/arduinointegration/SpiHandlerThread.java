@@ -42,6 +42,8 @@ public class SpiHandlerThread extends HandlerThread {
     private int sequence;               // sequence number for hello/ack
     private byte recBuff[] = new byte[REC_BUFF_LENG];    // receive buffer
     private int recBuffp;               // receive buffer pointer
+    private boolean useBinary = true;   // ask for binary sample records (see SampleRecord)
+    private SampleRecord.Decoder decoder = new SampleRecord.Decoder();
 
 
 
@@ -113,6 +115,22 @@ public class SpiHandlerThread extends HandlerThread {
 
                 case IDLE:
 
+                    /* Ask for binary sample records, which start with a
+                     * TIME record. */
+
+                    if (useBinary) {
+                        try {
+                            byte[] data = ("binary: on" + "\n").getBytes("UTF-8");
+                            mSpiDevice.write(data, data.length);
+                            decoder.reset();
+                            sleep(150);
+                        } catch (IOException e) {
+                            Log.d(TAG, "IDLE: write of \"binary: on\" failed.");
+                        } catch (InterruptedException e) {
+                            Log.d(TAG, "IDLE: sleep interrupted.");
+                        }
+                    }
+
                     /* Send "hello <seq>" messages to slave. */
 
                     try {
@@ -276,6 +294,21 @@ public class SpiHandlerThread extends HandlerThread {
                         break;
                     }
 
+                    /* Binary mode: decode the records, before the hack below
+                     * clears the top bit of the first one. */
+
+                    if (useBinary && SampleRecord.isRecord(recBuff[0])) {
+                        state = decodeRecords() ? LINK_ESTABLISHED : IDLE;
+
+                        try {           // wait before sending "send temp"
+                            sleep(5000);
+                        } catch (InterruptedException e) {
+                            Log.d(TAG, "SEND_SENT: sleep interrupted");
+                        }
+
+                        break;
+                    }
+
                     /* Check to see if received message is an ack. */
 
                     recString = "yyy";
@@ -333,6 +366,9 @@ public class SpiHandlerThread extends HandlerThread {
                         Log.d(TAG, "temp: received " + tokens[1]);
                         activity.setI2CTemp(Double.valueOf(tokens[1]));
                         state = LINK_ESTABLISHED;
+                    } else if (tokens[0].equals("same:")) {
+                        Log.d(TAG, "same: temp unchanged");    // deadband mode: keep last value
+                        state = LINK_ESTABLISHED;
                     } else {
                         Log.d(TAG, "Unexpected response to \"send temp\"");
                         state = IDLE;
@@ -402,4 +438,28 @@ public class SpiHandlerThread extends HandlerThread {
             }
         }
     }
+
+
+
+    /* decodeRecords - decode the sample records in recBuff (see
+     * SampleRecord), and show the latest temperature.  Returns false if
+     * recBuff does not hold a TEMP record.
+     */
+
+    private boolean decodeRecords() {
+
+        boolean found = false;
+
+        for (int off = 0; off + SampleRecord.LENGTH <= recBuff.length; off += SampleRecord.LENGTH) {
+            SampleRecord r = decoder.decode(recBuff, off);
+            if (r == null) break;
+            if (r.type == SampleRecord.TEMP) {
+                Log.d(TAG, String.format("rec: seq %d time %d temp %.1f%s", r.seq, r.time,
+                        r.value, ((r.flags & SampleRecord.FLAG_SAME) != 0) ? " (same)" : ""));
+                activity.setSPITemp(r.value);
+                found = true;
+            }
+        }
+        return found;
+    }
 }
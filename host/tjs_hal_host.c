@@ -0,0 +1,614 @@
+/* tjs_hal_host.c - simulated ATmega32U4 peripherals for the host build.
+ *
+ * "make host" builds the firmware, unchanged, with this file as a native
+ * Linux process (host/tjsHost).  A 1 msec SIGALRM interval timer is the
+ * interrupt controller: halHostTick() runs the firmware's ISRs whenever
+ * the I bit in the simulated SREG is set, exactly as the AVR would after
+ * a cli() / sei() window.
+ *
+ * Harness (standard input and output):
+ *
+ *   - stdout is the USART transmit line.  Bytes leave at the bit rate
+ *     programmed in UBRR1 (57600 bps), with the firmware's "\r\n" line
+ *     endings.
+ *   - stdin is the USART receive line, also paced at the bit rate.  "\n"
+ *     is delivered as "\r", the command terminator the firmware expects
+ *     from a terminal, and the next line waits TJS_LINE_DELAY msec
+ *     (default 20), as a user at a terminal would.  Set it to 0 to see
+ *     what happens when commands arrive back to back.
+ *   - A line of the form "@i2c <command>" or "@spi <command>" is not sent
+ *     to the USART.  Instead the harness acts as the bus master: it writes
+ *     "<command>\n" to the slave through the TWI (or SPI) ISR, waits
+ *     TJS_BUS_DELAY msec (default 150, as the Android app does), reads the
+ *     reply the same way, and
+ *     prints it as "@i2c <reply>" (or "@spi <reply>"); binary records
+ *     are printed in hex, as "@i2c rec: <bytes>".  Later input waits
+ *     until the transaction is complete.  Replies always start on a new
+ *     line of the output.
+ *   - At end of input, the process exits once every queued command has
+ *     been processed and it has been idle for TJS_LINGER msec (default
+ *     100), so scripted runs terminate.
+ *
+ * The ADC returns TJS_ADC (default 278, about 25 C from the temperature
+ * sensor).
+ *
+ * Note: the ISRs run in the signal handler, so they may call C library
+ * functions (e.g., sprintf() in the I2C debug code) that the firmware is
+ * in the middle of.  This is good enough for a test harness.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "simpleSerial.h"
+#include "tjs_cmdq.h"
+#include "tjs_config.h"
+#include "tjs_hal.h"
+#include "tjs_record.h"
+
+/* Simulation parameters. */
+
+#define TICK_USEC 1000                  // interval timer period
+#define LINE_CREDIT_MSEC 4              // most line time saved up while idle
+#define BUS_REPLY_MAX 100               // longest reply read from a bus slave
+#define INPUT_BUFFER 4096               // stdin bytes not yet delivered
+
+/* Registers. */
+
+#define HAL_HOST_R8(name) volatile uint8_t name;
+#define HAL_HOST_R16(name) volatile uint16_t name;
+HAL_HOST_REGISTERS(HAL_HOST_R8, HAL_HOST_R16)
+
+volatile uint16_t UDR1;
+
+static volatile uint8_t adcsra;         // behind ADCSRA
+static volatile uint8_t tcnt4;          // behind TCNT4
+static volatile uint16_t tcnt1;         // behind TCNT1
+
+/* Simulation state. */
+
+static uint64_t startNsec;              // host time at startup
+static volatile uint64_t msecDelivered; // timer 4 interrupts delivered
+static uint64_t lastTickNsec;           // time of previous tick
+static uint64_t txCredit;               // USART line time available (nsec)
+static uint64_t rxCredit;
+
+static uint16_t adcValue = 278;         // TJS_ADC
+static unsigned int busDelay = 150;     // TJS_BUS_DELAY (msec)
+static unsigned int linger = 100;       // TJS_LINGER (msec)
+static unsigned int lineDelay = 20;     // TJS_LINE_DELAY (msec)
+
+static char input[INPUT_BUFFER];        // stdin, not yet delivered
+static int inputHead = 0;
+static int inputTail = 0;
+static int inputEof = 0;
+static int atLineStart = 1;             // next input byte starts a line
+static int lastWasCr = 0;               // last input byte was '\r'
+static uint64_t lastActivity;           // nsec of last input or bus transfer
+static uint64_t nextLineAt;             // nsec at which the next line may start
+static char lastOutput = '\n';          // last byte written to stdout
+
+static enum {BUS_IDLE, BUS_REPLY_WAIT} busState = BUS_IDLE;
+static int busIsI2c;                    // transaction is I2C (else SPI)
+static uint64_t busReplyAt;             // nsec at which to read the reply
+
+
+
+/* Vectors of transports compiled out (see tjs_config.h), which the AVR
+ * would send to __bad_interrupt.  Never run: their enables stay clear.
+ */
+
+#if !CONFIG_ASYNC
+void USART1_RX_vect(void) {}
+#endif
+#if !CONFIG_I2C
+void TWI_vect(void) {}
+#endif
+#if !CONFIG_SPI
+void SPI_STC_vect(void) {}
+#endif
+
+
+
+/* nowNsec - host monotonic clock, in nsec since startup.
+ */
+
+static uint64_t nowNsec(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec - startNsec;
+}
+
+
+
+/* byteNsec - time to send one 10-bit frame at the bit rate in UBRR1.
+ */
+
+static uint64_t byteNsec(void) {
+	return 10ull * 16 * (UBRR1 + 1) * 1000000000ull / F_CPU;
+}
+
+
+
+/* writeAll - write(2) all of buf to stdout (async-signal-safe).
+ */
+
+static void writeAll(const char *buf, size_t n) {
+
+	if (n > 0) lastOutput = buf[n - 1];
+	while (n > 0) {
+		ssize_t w = write(1, buf, n);
+		if (w < 0) {
+			if (errno == EINTR) continue;
+			return;
+		}
+		buf += w;
+		n -= w;
+	}
+}
+
+
+
+/* Register accessors. */
+
+volatile uint8_t *halHostAdcsra(void) {
+
+	if (adcsra & _BV(ADSC)) {           // conversion started: complete it
+		ADC = adcValue;
+		adcsra &= ~_BV(ADSC);
+	}
+	return &adcsra;
+}
+
+
+volatile uint8_t *halHostTcnt4(void) {
+
+	/* Count from the last delivered compare match, and stop at TOP if the
+	 * next one is overdue, so getTimestamp() never goes backwards. */
+
+	int64_t ticks = ((int64_t)nowNsec() - (int64_t)msecDelivered * 1000000) / 4000;
+	if (ticks < 0) ticks = 0;
+	if (ticks > OCR4C) ticks = OCR4C;
+	tcnt4 = ticks;
+	return &tcnt4;
+}
+
+
+volatile uint16_t *halHostTcnt1(void) {
+	tcnt1 = nowNsec() * (F_CPU / 1000000) / 1000;    // CPU cycles, clk/1
+	return &tcnt1;
+}
+
+
+
+/* USART transmit - run the data register empty ISR while it is enabled
+ * and there is line time for another byte.
+ */
+
+static void uartTransmit(void) {
+
+	char out[256];
+	size_t n = 0;
+	uint64_t frame = byteNsec();
+
+	while ((UCSR1B & _BV(TXEN1)) && (UCSR1B & _BV(UDRIE1)) &&
+	       (txCredit >= frame) && (n < sizeof(out))) {
+		UDR1 = 0x100;                   // no byte written (yet)
+		USART1_UDRE_vect();
+		if (UDR1 > 0xff) continue;      // ISR disabled itself
+		out[n++] = UDR1;
+		txCredit -= frame;
+	}
+	if (!(UCSR1B & _BV(UDRIE1)) && (txCredit > LINE_CREDIT_MSEC * 1000000ull)) {
+		txCredit = LINE_CREDIT_MSEC * 1000000ull;    // idle line
+	}
+	writeAll(out, n);
+}
+
+
+
+/* twiEvent - present a TWI status to the slave, and run its ISR.
+ */
+
+static void twiEvent(uint8_t status) {
+	TWSR = status;
+	if (TWCR & _BV(TWIE)) TWI_vect();
+}
+
+
+
+/* spiTransfer - exchange one byte with the SPI slave.  The master
+ * receives whatever was in SPDR when the transfer started.
+ */
+
+static uint8_t spiTransfer(uint8_t mosi) {
+
+	uint8_t miso = SPDR;
+
+	SPDR = mosi;
+	SPSR |= _BV(SPIF);
+	if (SPCR & _BV(SPIE)) SPI_STC_vect();
+	SPSR &= ~_BV(SPIF);
+	return miso;
+}
+
+
+
+/* busWrite - start an "@i2c" or "@spi" transaction: write the command.
+ * Returns 0 if the interface is not enabled yet.
+ */
+
+static int busWrite(const char *line, int length) {
+
+	int i;
+
+	if (CONFIG_I2C && (strncmp(line, "@i2c ", 5) == 0)) {
+		if (!(TWCR & _BV(TWEN))) return 0;
+		busIsI2c = 1;
+		twiEvent(TW_SR_SLA_ACK);
+		for (i = 5; i < length; i++) {
+			TWDR = line[i];
+			twiEvent(TW_SR_DATA_ACK);
+		}
+		TWDR = '\n';
+		twiEvent(TW_SR_DATA_ACK);
+		twiEvent(TW_SR_STOP);
+	} else if (CONFIG_SPI && (strncmp(line, "@spi ", 5) == 0)) {
+		if (!(SPCR & _BV(SPE))) return 0;
+		busIsI2c = 0;
+		for (i = 5; i < length; i++) spiTransfer(line[i]);
+		spiTransfer('\n');
+	} else {
+		writeAll("@nack\n", 6);         // unknown bus, or compiled out
+		return 1;
+	}
+	busState = BUS_REPLY_WAIT;
+	busReplyAt = nowNsec() + busDelay * 1000000ull;
+	return 1;
+}
+
+
+
+/* busRead - read the slave's reply, and print it.  A reply whose first
+ * byte has the top bit set is binary (see tjs_record.h): its records are
+ * printed in hex, as "@i2c rec: <bytes>".
+ */
+
+static void busRead(void) {
+
+	uint8_t raw[BUS_REPLY_MAX];
+	char reply[3 * BUS_REPLY_MAX + 12];    // "@i2c rec:" reply "\n"
+	int binary = 0;
+	int length = 0;
+	int n;
+
+	if (busIsI2c) {
+		twiEvent(TW_ST_SLA_ACK);
+		while (length < BUS_REPLY_MAX) {
+			uint8_t ch = TWDR;
+			if (length == 0) binary = ch & RECORD_MARK;
+			int more = (TWCR & _BV(TWEA)) &&
+			           (binary || ((ch != '\n') && (ch != 0)));
+			raw[length++] = ch;
+			if (!more) break;
+			twiEvent(TW_ST_DATA_ACK);
+		}
+		twiEvent(TW_ST_DATA_NACK);
+		if (binary) length -= length % RECORD_LENGTH;    // NUL after the end
+	} else {
+		while (length < BUS_REPLY_MAX) {
+			uint8_t ch = spiTransfer(0);
+			if (length == 0) binary = ch & RECORD_MARK;
+			if (binary && (length % RECORD_LENGTH == 0) && !(ch & RECORD_MARK)) break;
+			if (!binary && ((ch == 0) || (ch == '\n'))) break;
+			raw[length++] = ch;
+		}
+	}
+
+	n = sprintf(reply, "@%s", busIsI2c ? "i2c" : "spi");
+	if (binary) {
+		n += sprintf(&reply[n], " rec:");
+		for (int i = 0; i < length; i++) {
+			n += sprintf(&reply[n], " %02x", raw[i]);
+		}
+	} else {
+		reply[n++] = ' ';
+		for (int i = 0; i < length; i++) {
+			if ((raw[i] != 0) && (raw[i] != '\r') && (raw[i] != '\n')) reply[n++] = raw[i];
+		}
+	}
+	reply[n++] = '\n';
+	if (lastOutput != '\n') writeAll("\n", 1);
+	writeAll(reply, n);
+	busState = BUS_IDLE;
+}
+
+
+
+/* readInput - move whatever is available on stdin into input[].
+ */
+
+static void readInput(void) {
+
+	struct pollfd p = {0, POLLIN, 0};
+
+	if (inputEof) return;
+	if (inputHead == inputTail) inputHead = inputTail = 0;
+	if ((inputTail == sizeof(input)) && (inputHead > 0)) {
+		memmove(input, &input[inputHead], inputTail - inputHead);
+		inputTail -= inputHead;
+		inputHead = 0;
+	}
+	if (inputTail == sizeof(input)) return;
+	if (poll(&p, 1, 0) <= 0) return;
+
+	ssize_t n = read(0, &input[inputTail], sizeof(input) - inputTail);
+	if (n > 0) {
+		inputTail += n;
+	} else if ((n == 0) || (errno != EINTR)) {
+		inputEof = 1;
+	}
+}
+
+
+
+/* uartReceive - deliver input to the receive ISR at the bit rate, and
+ * start bus transactions.
+ */
+
+static void uartReceive(void) {
+
+	uint64_t frame = byteNsec();
+
+	while ((busState == BUS_IDLE) && (inputHead < inputTail)) {
+
+		if (atLineStart && (input[inputHead] == '@')) {
+			char *line = &input[inputHead];
+			char *end = memchr(line, '\n', inputTail - inputHead);
+			if (end == NULL) {
+				if (!inputEof && (inputTail - inputHead < sizeof(input))) break;
+				end = &input[inputTail];    // last line, unterminated
+			}
+			if (!busWrite(line, end - line)) break;
+			inputHead = end - input;
+			if (inputHead < inputTail) inputHead++;    // eat '\n'
+			lastActivity = nowNsec();
+			continue;
+		}
+
+		/* Wait for the receiver to be enabled; if the async interface is
+		 * compiled out, it never is, and input is lost once the USART is up,
+		 * as on the wire. */
+
+		uint8_t up = CONFIG_ASYNC ? (UCSR1B & _BV(RXEN1)) : (UCSR1B & _BV(TXEN1));
+		if (!up || (rxCredit < frame)) break;
+		if (atLineStart && (nowNsec() < nextLineAt)) break;
+
+		char ch = input[inputHead++];
+		uint8_t afterCr = lastWasCr;
+		lastWasCr = (ch == '\r');      // before '\n' becomes '\r'
+		atLineStart = (ch == '\n');
+		if (ch == '\n') {
+			if (afterCr) continue;      // "\r\n": '\r' already sent
+			ch = '\r';
+		}
+		if (ch == '\r') {
+			atLineStart = 1;
+			nextLineAt = nowNsec() + lineDelay * 1000000ull;
+		}
+		rxCredit -= frame;
+		UDR1 = (uint8_t)ch;
+		UCSR1A &= ~(_BV(FE1) | _BV(DOR1));
+		if (UCSR1B & _BV(RXCIE1)) USART1_RX_vect();
+		lastActivity = nowNsec();
+	}
+	if (rxCredit > LINE_CREDIT_MSEC * 1000000ull) {
+		rxCredit = LINE_CREDIT_MSEC * 1000000ull;
+	}
+}
+
+
+
+/* commandsDone - return 1 if no interface has a command queued.
+ */
+
+static int commandsDone(void) {
+
+	int i;
+
+	for (i = 0; i < INTERFACES; i++) {
+		if (cmdqFront(&cmdQueues[i]) != NULL) return 0;
+	}
+	return 1;
+}
+
+
+
+/* halHostTick - the interrupt controller.  Runs every msec (SIGALRM).
+ */
+
+static void halHostTick(int signal) {
+
+	int savedErrno = errno;
+	uint64_t now = nowNsec();
+	uint64_t due = now / 1000000;       // timer 4 interrupts due by now
+
+	txCredit += now - lastTickNsec;
+	rxCredit += now - lastTickNsec;
+	lastTickNsec = now;
+	readInput();
+
+	/* Interrupts disabled: leave them pending. */
+
+	if (!(SREG & 0x80)) {
+		if ((due > msecDelivered) && (TIMSK4 & _BV(OCIE4A))) TIFR4 |= _BV(OCF4A);
+		errno = savedErrno;
+		return;
+	}
+
+	uint8_t sreg = SREG;
+	SREG = sreg & ~0x80;                // ISRs run with interrupts disabled
+
+	while (msecDelivered < due) {
+		msecDelivered++;
+		TIFR4 &= ~_BV(OCF4A);
+		if (TIMSK4 & _BV(OCIE4A)) TIMER4_COMPA_vect();
+	}
+	uartTransmit();
+	uartReceive();
+	if ((busState == BUS_REPLY_WAIT) && (now >= busReplyAt)) {
+		busRead();
+		lastActivity = now;
+	}
+
+	SREG = sreg;
+
+	/* End of input: exit once everything has gone quiet.  (The clock is
+	 * read again: uartReceive() may have just set lastActivity past now.) */
+
+	if (inputEof && (inputHead == inputTail) && (busState == BUS_IDLE) &&
+	    !(UCSR1B & _BV(UDRIE1)) && commandsDone() &&
+	    (nowNsec() - lastActivity >= linger * 1000000ull)) {
+		_exit(0);
+	}
+	errno = savedErrno;
+}
+
+
+
+/* halHostInit - start the simulation, before the firmware's main().
+ */
+
+static void halHostInit(void) __attribute__ ((constructor));
+
+static void halHostInit(void) {
+
+	struct sigaction sa;
+	struct itimerval it;
+	char *env;
+
+	startNsec = 0;
+	startNsec = nowNsec();
+	MCUSR = _BV(PORF);                  // power-on reset
+	lastTickNsec = 0;
+
+	if ((env = getenv("TJS_ADC")) != NULL) adcValue = atoi(env);
+	if ((env = getenv("TJS_BUS_DELAY")) != NULL) busDelay = atoi(env);
+	if ((env = getenv("TJS_LINGER")) != NULL) linger = atoi(env);
+	if ((env = getenv("TJS_LINE_DELAY")) != NULL) lineDelay = atoi(env);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = halHostTick;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGALRM, &sa, NULL);
+
+	it.it_interval.tv_sec = 0;
+	it.it_interval.tv_usec = TICK_USEC;
+	it.it_value = it.it_interval;
+	setitimer(ITIMER_REAL, &it, NULL);
+}
+
+
+
+/* halHostSleep - sleep_cpu(): wait for the next interrupt.
+ */
+
+void halHostSleep(void) {
+	pause();
+}
+
+
+
+/* _delay_ms, _delay_us - busy-wait delays; here, real sleeps.
+ */
+
+static void delayNsec(uint64_t nsec) {
+
+	struct timespec ts, rem;
+
+	ts.tv_sec = nsec / 1000000000ull;
+	ts.tv_nsec = nsec % 1000000000ull;
+	while ((nanosleep(&ts, &rem) < 0) && (errno == EINTR)) ts = rem;
+}
+
+
+void _delay_ms(double msec) {
+	delayNsec((uint64_t)(msec * 1000000.0));
+}
+
+
+void _delay_us(double usec) {
+	delayNsec((uint64_t)(usec * 1000.0));
+}
+
+
+
+/* boot_signature_byte_get - the signature row is erased (0xff).
+ */
+
+uint8_t boot_signature_byte_get(uint16_t address) {
+	return 0xff;
+}
+
+
+
+/* halHostStdio - HAL_STDIO_INIT(): send stdout through uart_putchar(),
+ * like the avr-libc stream in simpleSerial.c.
+ */
+
+static ssize_t uartWrite(void *cookie, const char *buf, size_t size) {
+
+	size_t i;
+
+	for (i = 0; i < size; i++) uart_putchar(buf[i], stdout);
+	return size;
+}
+
+
+void halHostStdio(void) {
+
+	cookie_io_functions_t functions = {NULL, uartWrite, NULL, NULL};
+
+	stdout = fopencookie(NULL, "w", functions);
+	setvbuf(stdout, NULL, _IONBF, 0);
+}
+
+
+
+/* strlcpy, strlcat - as in avr-libc (and BSD).
+ */
+
+size_t strlcpy(char *dst, const char *src, size_t size) {
+
+	size_t length = strlen(src);
+
+	if (size > 0) {
+		size_t n = (length < size - 1) ? length : size - 1;
+		memcpy(dst, src, n);
+		dst[n] = '\0';
+	}
+	return length;
+}
+
+
+size_t strlcat(char *dst, const char *src, size_t size) {
+
+	size_t used = strnlen(dst, size);
+
+	if (used == size) return size + strlen(src);
+	return used + strlcpy(dst + used, src, size - used);
+}
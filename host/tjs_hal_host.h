@@ -0,0 +1,144 @@
+/* tjs_hal_host.h - host (Linux) backend of the hardware abstraction layer.
+ *
+ * Included by tjs_hal.h when the firmware is built as a native process
+ * ("make host").  The ATmega32U4 registers the drivers use are ordinary
+ * variables, and tjs_hal_host.c simulates the peripherals behind them:
+ *
+ *   - SREG bit 7 is the global interrupt flag.  cli() and sei() clear and
+ *     set it, and the saved-SREG idiom works unchanged.
+ *   - A 1 msec interval timer (SIGALRM) plays the part of the interrupt
+ *     controller.  If interrupts are enabled it runs the real ISRs:
+ *     timer 4 compare match A once per msec, USART receive and data
+ *     register empty at the configured bit rate, and TWI and SPI for
+ *     transfers started by the bus harness.  If they are disabled the
+ *     interrupts stay pending (e.g., OCF4A in TIFR4) until the next tick.
+ *   - TCNT1 and TCNT4 follow the host clock; ADC conversions complete as
+ *     soon as ADCSRA is read.
+ *   - sleep_cpu() waits for the next signal; _delay_ms() sleeps.
+ *
+ * See tjs_hal_host.c for the harness (stdin, stdout and "@i2c"/"@spi"
+ * lines).
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_HAL_HOST_H
+#define TJS_HAL_HOST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <ctype.h>
+
+/* Registers.  Each entry is R8(name) or R16(name). */
+
+#define HAL_HOST_REGISTERS(R8, R16) \
+	R8(SREG) \
+	R8(UCSR1A) R8(UCSR1B) R8(UCSR1C) R16(UBRR1) \
+	R8(TWAR) R8(TWCR) R8(TWDR) R8(TWSR) \
+	R8(SPCR) R8(SPSR) R8(SPDR) \
+	R8(DDRB) R8(DDRC) R8(DDRD) R8(PORTB) R8(PORTC) R8(PORTD) \
+	R8(ADMUX) R8(ADCSRB) R8(DIDR0) R8(DIDR1) R16(ADC) \
+	R8(TCCR0A) R8(TCCR0B) R8(OCR0A) R8(TIMSK0) \
+	R8(TCCR1A) R8(TCCR1B) R8(TCCR1C) R8(TIMSK1) \
+	R8(TCCR4A) R8(TCCR4B) R8(TCCR4C) R8(TCCR4D) R8(TCCR4E) R8(TC4H) \
+	R8(OCR4A) R8(OCR4B) R8(OCR4C) R8(OCR4D) R8(TIMSK4) R8(TIFR4) R8(DT4) \
+	R8(USBCON) R8(SMCR) R8(MCUSR)
+
+#define HAL_HOST_R8(name) extern volatile uint8_t name;
+#define HAL_HOST_R16(name) extern volatile uint16_t name;
+HAL_HOST_REGISTERS(HAL_HOST_R8, HAL_HOST_R16)
+#undef HAL_HOST_R8
+#undef HAL_HOST_R16
+
+/* UDR1 is wider than on the AVR, so the simulation can tell whether the
+ * data register empty ISR wrote a byte (values above 0xff are never
+ * written by the firmware). */
+
+extern volatile uint16_t UDR1;
+
+/* Registers with side effects are reached through accessors. */
+
+volatile uint8_t *halHostAdcsra(void);  // completes a started conversion
+volatile uint8_t *halHostTcnt4(void);   // timer 4 count, from the host clock
+volatile uint16_t *halHostTcnt1(void);  // timer 1 count (CPU cycles)
+
+#define ADCSRA (*halHostAdcsra())
+#define TCNT4 (*halHostTcnt4())
+#define TCNT1 (*halHostTcnt1())
+
+/* Register bits. */
+
+enum {
+	RXC1 = 7, TXC1 = 6, UDRE1 = 5, FE1 = 4, DOR1 = 3, UPE1 = 2,
+	RXCIE1 = 7, TXCIE1 = 6, UDRIE1 = 5, RXEN1 = 4, TXEN1 = 3,
+	UCSZ11 = 2, UCSZ10 = 1,
+	TWINT = 7, TWEA = 6, TWEN = 2, TWIE = 0,
+	SPIE = 7, SPE = 6, SPIF = 7, WCOL = 6,
+	REFS1 = 7, REFS0 = 6, ADEN = 7, ADSC = 6, ADPS2 = 2, ADPS1 = 1,
+	ADPS0 = 0, MUX5 = 5,
+	WGM01 = 1, CS01 = 1, CS00 = 0, OCIE0A = 1, CS10 = 0,
+	CS42 = 2, CS41 = 1, CS40 = 0,
+	OCIE4D = 7, OCIE4A = 6, OCIE4B = 5, TOV4 = 2, OCF4A = 6,
+	PORF = 0, EXTRF = 1, BORF = 2, WDRF = 3, JTRF = 4,
+	DD3 = 3, DDB0 = 0, DDB4 = 4, DDB6 = 6, DDC7 = 7, DDD5 = 5, DDD6 = 6,
+	PORTB0 = 0, PORTC7 = 7, PORTD5 = 5, PB4 = 4, PB6 = 6, PD6 = 6
+};
+
+#define _BV(bit) (1 << (bit))
+#define RAMEND 0x0AFF
+
+/* TWI status codes (<util/twi.h>). */
+
+#define TW_STATUS (TWSR & 0xF8)
+#define TW_BUS_ERROR 0x00
+#define TW_SR_SLA_ACK 0x60
+#define TW_SR_DATA_ACK 0x80
+#define TW_SR_DATA_NACK 0x88
+#define TW_SR_STOP 0xA0
+#define TW_ST_SLA_ACK 0xA8
+#define TW_ST_DATA_ACK 0xB8
+#define TW_ST_DATA_NACK 0xC0
+#define TW_ST_LAST_DATA 0xC8
+
+/* Interrupts. */
+
+#define ISR(vector, ...) void vector(void)
+#define cli() do { SREG &= (uint8_t)~0x80; __asm__ volatile ("" ::: "memory"); } while (0)
+#define sei() do { __asm__ volatile ("" ::: "memory"); SREG |= 0x80; } while (0)
+
+void USART1_RX_vect(void);
+void USART1_UDRE_vect(void);
+void TWI_vect(void);
+void SPI_STC_vect(void);
+void TIMER4_COMPA_vect(void);
+
+/* Sleep, the watchdog (never started here), delays, and the signature
+ * row. */
+
+#define SLEEP_MODE_IDLE 0
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable() ((void)0)
+#define sleep_disable() ((void)0)
+#define sleep_cpu() halHostSleep()
+#define wdt_disable() ((void)0)
+
+void halHostSleep(void);                // wait for an interrupt
+void _delay_ms(double msec);
+void _delay_us(double usec);
+uint8_t boot_signature_byte_get(uint16_t address);
+
+/* stdio.  The avr-libc streams are not used; stdout writes through
+ * uart_putchar() instead. */
+
+#define FDEV_SETUP_STREAM(put, get, rwflag) {0}
+#define HAL_STDIO_INIT(out, in) halHostStdio()
+
+void halHostStdio(void);
+
+/* avr-libc functions missing from older C libraries. */
+
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+
+#endif
@@ -12,10 +12,7 @@
 #define F_CPU 16000000ul
 
 #include <stdio.h>
-#include <avr/boot.h>
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* TJS includes. */
@@ -24,12 +21,32 @@
 #include <stdio.h>
 #include "simpleSerial.h"
 #include "tjs_adc.h"
+#include "tjs_cmdq.h"
+#include "tjs_config.h"
+#include "tjs_crc.h"
+#include "tjs_deadband.h"
+#include "tjs_hal.h"
+#include "tjs_history.h"
+#include "tjs_history_cmd.h"
+#include "tjs_interfaces.h"
+#include "tjs_leds.h"
+#include "tjs_linkstats.h"
+#include "tjs_memory.h"
 #include "tjs_msec_clock.h"
+#include "tjs_parse.h"
+#include "tjs_record.h"
+#include "tjs_reliable.h"
+#include "tjs_reply.h"
+#include "tjs_sched.h"
+#include "tjs_status.h"
+#include "tjs_subscribe.h"
 #include "tjs_temp.h"
+#include "tjs_timer.h"
+#include "tjs_timesync.h"
+#include "tjs_window.h"
 #include "tjsI2cSlave.h"
 #include "tjsSpiSlave.h"
 //#include "cpu_clock.h"
-//#include "tjs_leds.h"
 
 
 /* I2C Slave Address. */
@@ -37,11 +54,9 @@
 #define I2C_ADDR 0x77
 
 
-/* Define Interfaces */
+/* Interfaces (see tjs_interfaces.h). */
 
-#define INTERFACE_ASYNC 0
-#define INTERFACE_I2C 1
-#define INTERFACE_SPI
+int commandInterface = INTERFACE_ASYNC; // interface of command being processed
 
 
 /* Forward References. */
@@ -49,7 +64,19 @@
 char* processNullCommand(char *);
 char* processPCommand(char *);
 char* processHelloCommand(char *);
-char* processOnOffCommand(int *, char *);
+char* processSendCommand(char *);
+char* processNoReplyCommand(char *);
+char* processOnOffCommand(int *, PGM_P);
+
+void sampleTemperature(void);
+void printState(void);
+void pushTemperature(void);
+void bootDone(void);
+
+void printDebugMessage(void);
+void processAsyncCommand(void);
+void processI2cInput(void);
+void processSpiInput(void);
 
 
 
@@ -58,52 +85,34 @@ char* processOnOffCommand(int *, char *);
 unsigned long int timeLast = 0;         // previous time
 unsigned long int timeNow = 0;          // time of latest reading
 
-/* User command input processing. */
-
-extern  char recv_buffer[];                 // buffer containing user command
-extern  uint8_t recv_buffer_ptr;            // pointer into recv_buffer
-extern  unsigned int user_command_ready;    // set if user command received
-
 /* Flags to control printing of state information and other activities. */
 
 int printDetailedInfo = 1;              // enables periodic printing of globla state
 int printFinegrainedInfo = 0;           // enables printing of fine-grained info
 int readTempSensor = 1;                 // enables reading of temperature sensors
 
-/* I2C  input processing. */
-
-#define I2C_BUFFER_LENGTH 50
-
-extern unsigned char i2cRxBuffer[I2C_RX_BUFFER_LENGTH];  // buffer containing I2C command
-extern int i2cRxBufferp;                // pointer into i2CRecvBuffer
-extern unsigned int i2cCommandReady;    // set if i2c command received
-extern int i2cRxBufferpOld;	    		// DEBUG: old i2cRecvBufferp
-
-/* I2C transmit buffer */
-
-extern unsigned char i2cTxBuffer[I2C_TX_BUFFER_LENGTH];
-extern int i2cTxBufferp;
+/* Periodic activities (software timer periods). */
 
-/* I2C  input processing. */
-
-#define SPI_BUFFER_LENGTH 50
-
-extern unsigned char spiRxBuffer[SPI_RX_BUFFER_LENGTH];  // buffer containing SPI command
-extern int spiRxBufferp;                // pointer into spiRecvBuffer
-extern unsigned int spiCommandReady;    // set if spi command received
-extern int spiRxBufferpOld;	    		// DEBUG: old spiRecvBufferp
-
-/* SPI transmit buffer */
-
-extern unsigned char spiTxBuffer[SPI_TX_BUFFER_LENGTH];
-extern int spiTxBufferp;
+unsigned int tempPeriod = 100;          // read temp every 100 msec
+unsigned int printPeriod = 1000;        // print state every second
 
 /* Debug print buffer */
 
+#if CONFIG_DEBUG
 unsigned char debugBuffer[500];
 int debugCommandReady = 0;
+#endif
 
 char tempString[20];
+int16_t tempDeciValue;                  // latest temp, in 0.1 degrees C
+unsigned long tempTime;                 // msec clock of latest temp
+
+/* Report-by-exception state: of "send: temp" replies, per interface, and
+ * of the readings pushed on the async interface.  A poll must not reset
+ * the pushed stream's last value or heartbeat. */
+
+deadbandState deadband[INTERFACES];
+deadbandState deadbandPush;
 
 
 /****** main() ******/
@@ -112,150 +121,314 @@ int main(void) {
 	
 	USBCON = 0;
 
-	/* Initialize everything. */
+	/* Initialize everything.  The transports and sampling come up first,
+	 * so a host polling over I2C or SPI after a reset is answered within
+	 * a few msec; the boot blink and the banner follow without blocking. */
 	
 	cli();
 
+	statusInit();                       // save reset cause
+
+	initializeMsecClock();              // boot times are measured from here
+	startMsecClock();
+
+	linkStatsInit();                    // start interface statistics
+
+	for (uint8_t i = 0; i < INTERFACES; i++) {
+		cmdqInit(&cmdQueues[i]);        // empty command queues
+		parseInit(&cmdParsers[i]);      // and their tokenizers
+	}
+
 	initAdc();                          // initialize ADC
 	
+#if CONFIG_I2C
 	tjsI2cInit(I2C_ADDR);				// initialize I2C slave
+#endif
 
+#if CONFIG_SPI
 	tjsSpiInit();						// initialize SPI slave
+#endif
+
+    uart_init();
+
+    HAL_STDIO_INIT(mystdout, mystdin);	// make avr-libc functions work
 
 	/* Register command processors. */
 
-    registerUserCommand("", processNullCommand);
-    registerUserCommand("p", processPCommand);
-	registerUserCommand("P", processPCommand);
-	registerUserCommand("hello:", processHelloCommand);
-
-	/* Blink red LED to confirm board booted up (and detect reboots). */
-
-	enableRedLED();
-	enableYellowLED();
-	enableGreenLED();
-	onRedLED();
-	_delay_ms(500);
-	offRedLED();
-	_delay_ms(500);
-	onRedLED();
-	_delay_ms(500);
-	offRedLED();
-
-    /* print banner. */
+    registerUserCommand(PSTR(""), processNullCommand);
+    registerUserCommand(PSTR("p"), processPCommand);
+	registerUserCommand(PSTR("P"), processPCommand);
+	registerUserCommand(PSTR("hello:"), processHelloCommand);
+	registerUserCommand(PSTR("send:"), processSendCommand);
+	registerQuietCommand(PSTR("$:"), processNoReplyCommand);
+	registerUserCommand(PSTR("history:"), processHistoryCommand);
+	registerUserCommand(PSTR("deadband:"), processDeadbandCommand);
+	registerUserCommand(PSTR("agg:"), processWindowCommand);
+	registerUserCommand(PSTR("sched:"), processSchedCommand);
+	registerUserCommand(PSTR("sync:"), processSyncCommand);
+	registerUserCommand(PSTR("time:"), processTimeCommand);
+	registerUserCommand(PSTR("stats:"), processStatsCommand);
+	registerUserCommand(PSTR("mem:"), processMemCommand);
+	registerUserCommand(PSTR("status:"), processStatusCommand);
+	registerUserCommand(PSTR("subscribe:"), processSubscribeCommand);
+	registerUserCommand(PSTR("unsubscribe:"), processUnsubscribeCommand);
+	registerUserCommand(PSTR("reliable:"), processReliableCommand);
+	registerQuietCommand(PSTR("rack:"), processRackCommand);
+	registerUserCommand(PSTR("crc:"), processCrcCommand);
+	registerUserCommand(PSTR("binary:"), processBinaryCommand);
+
+	historyInit(tempPeriod);            // keep compressed temp history
+
+	windowInit(getMsecClock());         // start windowed statistics
+
+	/* Start periodic activities: read the on-chip temperature sensor, and
+	 * print detailed state information. */
+
+	timerStart(sampleTemperature, 0, tempPeriod);
+	timerStart(printState, 0, printPeriod);
+
+	/* Blink red LED to confirm board booted up (and detect reboots), then
+	 * show the heartbeat. */
+
+	ledsInit();
+	timerStart(bootDone, 1500, 0);
+
+	/* Register tasks run by the scheduler. */
+
+#if CONFIG_DEBUG
+	schedRegister(EVENT_DEBUG, printDebugMessage);
+#endif
+#if CONFIG_ASYNC
+	schedRegister(EVENT_ASYNC_COMMAND, processAsyncCommand);
+#endif
+#if CONFIG_I2C
+	schedRegister(EVENT_I2C_COMMAND, processI2cInput);
+#endif
+#if CONFIG_SPI
+	schedRegister(EVENT_SPI_COMMAND, processSpiInput);
+#endif
+	schedRegister(EVENT_TIMER, runTimers);
+
+	statusReady();
+
+    /* print banner (interrupt driven; this enables interrupts). */
 	
-    uart_init();
+    printf_P(PSTR("\n\n"));
+    printf_P(PSTR("# Android Things / Arduino Integration\n"));
+    printf_P(PSTR("# Timothy J. Salo\n\n"));
 
-    stdout = &mystdout;					// make avr-libc functions work
-    stdin  = &mystdin;
+	/* Run tasks forever. */
 
-    printf("\n\n");
-    printf("# Android Things / Arduino Integration\n");
-    printf("# Timothy J. Salo\n\n");
-	
-	waitOutputComplete();
+	schedRun();
+}
 
-    /* Manage reading of on-chip temperature sensor. */
-	
-	unsigned long int tempNextTime = getMsecClock();    // last pot ADC time
-	unsigned int tempPeriod = 100;      // read temp every 100 msec
-	float tempLastValue = 9999.0f;      // last temp ADC value
-	float tempCurrentValue = 0.0f;      // current temp ADC value
 
-	/* Control printing of detailed state information. */
-	
-    unsigned long int printNextTime;    // next time to print
-    unsigned int printPeriod = 1000;    // print state every second
-	printNextTime = getMsecClock();     // set time for detailed info print
 
-	/* Fire up millisecond clock. */
-	
-	initializeMsecClock();
-	startMsecClock();
+#if CONFIG_DEBUG
 
-    /****** Main loop. ******/
-	
-	while(1) {
-
-        /* Check for debug message.
-		 * Note: this allows interrupt code to print something.
- 		 */
-
-		 if (debugCommandReady) {
-			printf(debugBuffer);
-			waitOutputComplete();
-			cli();
-            debugCommandReady = 0;
-			sei();
-        }
-		
-        /* Check for command on async interface. */
-    
-        if (user_command_ready) {
-	        printf("rx: %s\n", recv_buffer);
-			char *asyncString = processUserCommand(recv_buffer);
-			if (asyncString != NULL) printf(asyncString);
-            recv_buffer_ptr = 0;
-            recv_buffer[recv_buffer_ptr] = '\0';
-            user_command_ready = 0;
-        }
-		
-        /* Check for input on I2C interface.
-		 * Note: this allows command processing to run with interrupts enabled.
- 		 */
-    
-        if (i2cCommandReady) {
-			printf("I2C   rx: %s\n", i2cRxBuffer);
-			char *i2cString = processI2cCommand(i2cRxBuffer);
-			printf("I2C resp: %s\n", i2cString);
-			if (i2cString != NULL) {
-				strlcpy(i2cTxBuffer, i2cString, sizeof(i2cTxBuffer));
-				i2cTxBufferp = 0;
-			}
-			cli();
-            i2cRxBufferp = 0;
-            i2cRxBuffer[i2cRxBufferp] = '\0';
-            i2cCommandReady = 0;
-			sei();
-        }
-		
-        if (spiCommandReady) {
-			printf("SPI   rx: %s\n", i2cRxBuffer);
-			char *spiString = processSpiCommand(spiRxBuffer);
-			printf("SPI resp: %s\n", spiString);
-			if (spiString != NULL) {
-				strlcpy(spiTxBuffer, spiString, sizeof(spiTxBuffer));
-				spiTxBufferp = 0;
-			}
-			cli();
-            spiRxBufferp = 0;
-            spiRxBuffer[spiRxBufferp] = '\0';
-            spiCommandReady = 0;
-			sei();
-        }
-		
-	    /* Read on-chip temperature sensor every 100 milliseconds, if enabled. */
-		
-		if (getMsecClock() >= tempNextTime) {
-			if (readTempSensor) {
-				tempCurrentValue = readTemperatureSensor();
-                tempLastValue = tempCurrentValue;    // save current values
-                tempNextTime = getMsecClock() + tempPeriod;
-				sprintf(tempString, "temp: %4.1f\n", tempCurrentValue);
-			}
-        }
-		
-		/* Transmit detailed state information on ascyn interface every second. */
-		
-		if (getMsecClock() >= printNextTime) {
-			if (printDetailedInfo) {
-				printf(tempString);
-		    }
-
-            printNextTime = getMsecClock() + printPeriod;
-
-        }
-    }
+/* printDebugMessage - print debug message.
+ * Note: this allows interrupt code to print something.
+ */
+
+void printDebugMessage(void) {
+
+	if (debugCommandReady) {
+		uint8_t old = uart_set_class(UART_DEBUG);
+		printf(debugBuffer);
+		uart_set_class(old);
+		cli();
+		debugCommandReady = 0;
+		sei();
+	}
+}
+
+#endif
+
+
+
+#if CONFIG_ASYNC
+
+/* processAsyncCommand - process command on async interface.
+ * Processes the oldest queued command; if more are queued, the event is
+ * posted again, so the other tasks get a turn in between.
+ */
+
+void processAsyncCommand(void) {
+
+	cmdQueue *q = &cmdQueues[INTERFACE_ASYNC];
+	char *command = cmdqFront(q);
+
+	if (command != NULL) {
+		uint8_t length = cmdqFrontLength(q);
+		if (!userCommandQuiet(cmdqFrontTag(q))) parsePrint(PSTR("rx: "), command, length);
+		commandInterface = INTERFACE_ASYNC;
+		char *asyncString = processUserCommand(command, length, cmdqFrontTag(q));
+		uint8_t binary = (recordReplyLength != 0);    // binary reply (tjs_record.h)
+		length = binary ? recordReplyLength : (asyncString ? strlen(asyncString) : 0);
+		recordReplyLength = 0;
+		replySend(INTERFACE_ASYNC, asyncString, length, binary);
+		linkStatsLatency(INTERFACE_ASYNC, getTicks16() - schedCurrentPostTicks);
+		cmdqPop(q);
+		if (cmdqFront(q) != NULL) postEvent(EVENT_ASYNC_COMMAND);
+	}
+}
+
+#endif
+
+
+
+#if CONFIG_I2C
+
+/* processI2cInput - process command on I2C interface.
+ * Note: this allows command processing to run with interrupts enabled.
+ */
+
+void processI2cInput(void) {
+
+	cmdQueue *q = &cmdQueues[INTERFACE_I2C];
+	char *command = cmdqFront(q);
+
+	if (command != NULL) {
+		uint8_t old = uart_set_class(UART_DEBUG);
+		uint8_t length = cmdqFrontLength(q);
+		if (CONFIG_DEBUG) parsePrint(PSTR("I2C   rx: "), command, length);
+		commandInterface = INTERFACE_I2C;
+		char *i2cString = processI2cCommand(command, length, cmdqFrontTag(q));
+		uint8_t binary = (recordReplyLength != 0);    // binary reply (tjs_record.h)
+		length = binary ? recordReplyLength : (i2cString ? strlen(i2cString) : 0);
+		recordReplyLength = 0;
+		if (CONFIG_DEBUG) {
+			if (binary) printf_P(PSTR("I2C resp: %u binary bytes\n"), length);
+			else printf_P(PSTR("I2C resp: %s\n"), i2cString);
+		}
+		uart_set_class(old);
+		replySend(INTERFACE_I2C, i2cString, length, binary);
+		linkStatsLatency(INTERFACE_I2C, getTicks16() - schedCurrentPostTicks);
+		cmdqPop(q);
+		if (cmdqFront(q) != NULL) postEvent(EVENT_I2C_COMMAND);
+	}
+}
+
+#endif
+
+
+
+#if CONFIG_SPI
+
+/* processSpiInput - process command on SPI interface.
+ */
+
+void processSpiInput(void) {
+
+	cmdQueue *q = &cmdQueues[INTERFACE_SPI];
+	char *command = cmdqFront(q);
+
+	if (command != NULL) {
+		uint8_t old = uart_set_class(UART_DEBUG);
+		uint8_t length = cmdqFrontLength(q);
+		if (CONFIG_DEBUG) parsePrint(PSTR("SPI   rx: "), command, length);
+		commandInterface = INTERFACE_SPI;
+		char *spiString = processSpiCommand(command, length, cmdqFrontTag(q));
+		uint8_t binary = (recordReplyLength != 0);    // binary reply (tjs_record.h)
+		length = binary ? recordReplyLength : (spiString ? strlen(spiString) : 0);
+		recordReplyLength = 0;
+		if (CONFIG_DEBUG) {
+			if (binary) printf_P(PSTR("SPI resp: %u binary bytes\n"), length);
+			else printf_P(PSTR("SPI resp: %s\n"), spiString);
+		}
+		uart_set_class(old);
+		replySend(INTERFACE_SPI, spiString, length, binary);
+		linkStatsLatency(INTERFACE_SPI, getTicks16() - schedCurrentPostTicks);
+		cmdqPop(q);
+		if (cmdqFront(q) != NULL) postEvent(EVENT_SPI_COMMAND);
+	}
+}
+
+#endif
+
+
+
+/* sampleTemperature - read on-chip temperature sensor, if enabled.
+ * Runs every tempPeriod msec.
+ */
+
+void sampleTemperature(void) {
+
+	if (!readTempSensor) return;
+
+#if CONFIG_FLOAT
+	float tempCurrentValue = readTemperatureSensor();
+	unsigned long now = getMsecClock();
+
+	statusSample();                     // boot-to-first-sample time
+	sprintf_P(tempString, PSTR("temp: %4.1f\n"), tempCurrentValue);
+	tempDeciValue = (int16_t)(tempCurrentValue * 10.0f +
+	                          (tempCurrentValue < 0.0f ? -0.5f : 0.5f));
+#else
+	tempDeciValue = readTemperatureDeci();
+	unsigned long now = getMsecClock();
+
+	statusSample();                     // boot-to-first-sample time
+	uint16_t mag = (tempDeciValue < 0) ? -tempDeciValue : tempDeciValue;
+	sprintf_P(tempString, (tempDeciValue < 0) ? PSTR("temp: -%u.%u\n") :
+	          PSTR("temp: %2u.%u\n"), mag / 10, mag % 10);    // as "%4.1f"
+#endif
+	tempTime = now;
+	historyAdd(tempDeciValue, now);
+	windowAdd(tempDeciValue, now);
+	subscribeSample(tempDeciValue, now);    // push subscribed records
+
+	/* In deadband mode, push readings that changed (or are due a
+	 * heartbeat) instead of printing one every second. */
+
+	if (deadbandEnabled && printDetailedInfo &&
+	    deadbandCheck(&deadbandPush, tempDeciValue, now)) {
+		pushTemperature();
+	}
+}
+
+
+
+/* printState - transmit detailed state information on async interface.
+ * Runs every printPeriod msec.
+ */
+
+void printState(void) {
+	if (printDetailedInfo && !deadbandEnabled) pushTemperature();
+}
+
+
+
+/* pushTemperature - push the latest reading on the async interface: a
+ * "temp:" line, in reliable mode a numbered "rel:" record, or in binary
+ * mode a binary record.
+ */
+
+void pushTemperature(void) {
+
+	if (reliableEnabled) {
+		reliablePut(tempDeciValue, tempTime);
+		return;
+	}
+	uint8_t old = uart_set_class(UART_TELEMETRY);
+	if (recordBinary[INTERFACE_ASYNC]) {
+		uint8_t record[RECORD_MAX];
+		uint8_t length = recordSample(INTERFACE_ASYNC, record, tempDeciValue, tempTime, 0);
+		if (uart_write_record(record, length) < 0) recordDropped(INTERFACE_ASYNC);
+	} else {
+		printf(tempString);
+	}
+	uart_set_class(old);
+}
+
+
+
+/* bootDone - end the boot blink (red on, off, on at 500 msec intervals),
+ * and show the heartbeat.  Runs once, 1500 msec after boot.
+ */
+
+void bootDone(void) {
+	ledsPost(LED_STATUS_RUN);
 }
 
 
@@ -274,16 +447,72 @@ int main(void) {
 
 char* processHelloCommand(char *command) {
 	
-	static char string[30];
-	strlcpy(string, "ack:", sizeof(string));
-	char* token = strtok(NULL, " ");    // grab possible <sequence>
+	const uint8_t size = 30;
+	char *string = replySlot(size);
+	strlcpy_P(string, PSTR("ack:"), size);
+	char* token = nextArg();             // grab possible <sequence>
 	if (token != NULL) {
-		strlcat(string, " ", sizeof(string));
-		strlcat(string, token, sizeof(string));
+		strlcat_P(string, PSTR(" "), size);
+		strlcat(string, token, size);
 	}
-	strlcat(string, "\n", sizeof(string));
+	strlcat_P(string, PSTR("\n"), size);
 	return string;
 }
+
+
+
+/* processSendCommand - process "send: temp [<n> | since <seq>]" and
+ * "send: tempb [<n> | since <seq>]" commands.
+ *
+ * "send: temp" responds with the latest "temp: <value>" reading.  In
+ * deadband mode, it responds with "same:" if the reading has not changed
+ * enough since it was last sent over this interface.  In binary mode
+ * ("binary: on"), it responds with a binary record (see tjs_record.h),
+ * flagged RECORD_FLAG_SAME instead of "same:".
+ *
+ * With <n>, the last n samples are returned, and with "since <seq>", the
+ * samples from sequence number <seq> on, as many as fit in one reply (see
+ * historyBatch()).  "temp" returns them as text, "tempb" as hex-encoded
+ * binary.  A host can then poll as seldom as it likes without losing
+ * samples: it asks for "since <last seq + 1>".
+ */
+
+char* processSendCommand(char *command) {
+
+	char* token = nextArg();             // grab <what>
+	uint8_t binary;
+
+	if (token == NULL) return progmemReply(PSTR("nack:\n"));
+	if (strcmp_P(token, PSTR("temp")) == 0) binary = 0;
+	else if (strcmp_P(token, PSTR("tempb")) == 0) binary = 1;
+	else return progmemReply(PSTR("nack:\n"));
+
+	token = nextArg();                   // grab possible <n> or "since"
+	if (token == NULL) {
+		if (binary) return historyBatch(historyNextSeq() - 1, 1, 1);
+		uint8_t same = !deadbandCheck(&deadband[commandInterface], tempDeciValue, getMsecClock());
+		if (recordBinary[commandInterface]) {
+			return recordReply(tempDeciValue, tempTime, same ? RECORD_FLAG_SAME : 0);
+		}
+		if (same) return progmemReply(PSTR("same:\n"));
+		return tempString;
+	}
+	if (strcmp_P(token, PSTR("since")) == 0) {
+		token = nextArg();               // grab <seq>
+		if (token == NULL) return progmemReply(PSTR("nack:\n"));
+		return historyBatch((uint16_t)strtoul(token, NULL, 10), 0xffff, binary);
+	}
+	uint16_t n = (uint16_t)strtoul(token, NULL, 10);
+	return historyBatch(historyNextSeq() - n, n, binary);
+}
+
+
+/* processNoReplyCommand - process "$:" command, which has no response.
+ */
+
+char* processNoReplyCommand(char *command) {
+	return NULL;
+}
  
 
  /* processSCommand - process "P [on|off]" command to control printing of
@@ -293,16 +522,40 @@ char* processHelloCommand(char *command) {
  
 char* processPCommand(char *command) {
 	
-	return processOnOffCommand(&printDetailedInfo, "Detailed info printing");
+	return processOnOffCommand(&printDetailedInfo, PSTR("Detailed info printing"));
 }
 
 
-/* processNullCommand - return a list of commands in response to a null command. */
+/* processNullCommand - list the commands in response to a null command.
+ * The help text stays in flash.  On the async interface it is printed to
+ * the console in full; on I2C and SPI it is copied into the reply as one
+ * line, cut to fit the reply buffer.
+ */
+
+static const char helpText[] PROGMEM =
+	"Enter a commmand:\n\n"
+	" p [on | off]    Toggle / enable / disable printing of state information\n"
+	" P [on | off]\n\n";
 
 char* processNullCommand(char *command) {
-    return "Enter a commmand:\n\n"
-	       " p [on | off]    Toggle / enable / disable printing of state information\n"
-		   " P [on | off]\n\n";
+
+	if (commandInterface == INTERFACE_ASYNC) {
+		printf_P(helpText);
+		return NULL;
+	}
+
+	char *string = replySlot(REPLY_MAX);
+	uint8_t i;
+	uint8_t end = 0;
+
+	strlcpy_P(string, helpText, REPLY_MAX - 1);     // leave room for the '\n'
+	for (i = 0; string[i] != '\0'; i++) {
+		if (string[i] == '\n') string[i] = ' ';  // bus masters read one line
+		if (string[i] != ' ') end = i + 1;
+	}
+	string[end] = '\n';
+	string[end + 1] = '\0';
+	return string;
 }
 
 
@@ -312,32 +565,33 @@ char* processNullCommand(char *command) {
  * results may occur.
  */
  
-char* processOnOffCommand(int *flag, char *msg) {
+char* processOnOffCommand(int *flag, PGM_P msg) {
 
-	static char string[50];				// return value
+	const uint8_t size = 50;
+	char *string = replySlot(size);
 	
-	char* token = strtok(NULL, " ");    // grab possible "on" or "off"
+	char* token = nextArg();             // grab possible "on" or "off"
 	
-	if ((token == NULL) || (strcmp(token, "") == 0)) {
+	if ((token == NULL) || (strcmp_P(token, PSTR("")) == 0)) {
 		if (*flag) *flag = 0; else *flag = 1;    // toggle
-	} else if (strcmp(token, "on") == 0) {
+	} else if (strcmp_P(token, PSTR("on")) == 0) {
 		*flag = 1;
-	} else if (strcmp(token, "off") == 0) {
+	} else if (strcmp_P(token, PSTR("off")) == 0) {
 		*flag = 0;
 	} else {
 
-		strlcpy(string, "Unrecognized parameter: \"", sizeof(string));
-		strlcat(string, token, sizeof(string));
-		strlcat(string, "\"\n", sizeof(string));
+		strlcpy_P(string, PSTR("Unrecognized parameter: \""), size);
+		strlcat(string, token, size);
+		strlcat_P(string, PSTR("\"\n"), size);
 		return string;
 	}
 
-	strlcpy(string, "****** ", sizeof(string));
-	strlcat(string, msg, sizeof(string));
+	strlcpy_P(string, PSTR("****** "), size);
+	strlcat_P(string, msg, size);
 	if (*flag) {
-		strlcat(string, " enabled ******\n", sizeof(string));
+		strlcat_P(string, PSTR(" enabled ******\n"), size);
 	} else {
-		strlcat(string, " disabled ******\n", sizeof(string));
+		strlcat_P(string, PSTR(" disabled ******\n"), size);
 	}
 	
     return string;
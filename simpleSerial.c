@@ -98,29 +98,29 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <util/delay.h>
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
 
 #include "simpleSerial.h"
+#include "tjs_cmdq.h"
+#include "tjs_config.h"
+#include "tjs_crc.h"
+#include "tjs_hal.h"
 #include "tjs_leds.h"
+#include "tjs_linkstats.h"
+#include "tjs_parse.h"
+#include "tjs_record.h"
+#include "tjs_reply.h"
+#include "tjs_sched.h"
 
 /* simpleSerial constants. */
 // bit rate
 #define SIMPLE_SERIAL_BIT_RATE 38400
-// Transmit buffer size
-#define XMIT_BUFER_SIZE 200
-
-
-/* User command input processing. */
 
-#define RECEIVE_BUFFER_LENGTH 50
 
-volatile char recv_buffer[RECEIVE_BUFFER_LENGTH];    // does this need to be volatile?
-volatile uint8_t recv_buffer_ptr = 0;                // does this neet to be volatile?
-volatile unsigned int user_command_ready = 0;        // does this need to be volatile?
+/* stdio streams.  Defined here, rather than in simpleSerial.h, so that
+ * there is one copy in SRAM, not one per file that includes the header. */
 
+FILE mystdout = FDEV_SETUP_STREAM(uart_putchar, NULL, _FDEV_SETUP_WRITE);
+FILE mystdin = FDEV_SETUP_STREAM(NULL, uart_getchar, _FDEV_SETUP_READ);
 
 
 /* uart_init() - initialize USART port.
@@ -147,103 +147,199 @@ void uart_init() {
     UBRR1 = ((F_CPU/16)/57600 - 1);   	// set bit rate
     UCSR1C |= (1 << UCSZ11) | (1 << UCSZ10);    // 8 bit char size
     UCSR1B |= (1 << TXEN1);     		// enable transmit
+#if CONFIG_ASYNC                        // async commands (tjs_config.h)
     UCSR1B |= (1 << RXEN1);     		// enable receive
     UCSR1B |= (1 << RXCIE1);     		// enable interrupt on data receipt
+#endif
 	
 	SREG = sreg;						// restore interrupt state
 }
 
 
 
-/* Transmit buffer.
- * This buffers characters being transmitted.  As long as the buffer is not
- * full, programs should be able print to stdout without spin loops that wait
- * for the USART data register to be empty.  Rather uart_putchar employs
- * a spin lock only to wait for the buffer to be not full (specifically to
- * wait for one character to available to accept transmitted data).
+/* Transmit queues.
+ * Output is queued by priority class (see simpleSerial.h): control
+ * replies, telemetry, and debug output each have their own circular
+ * buffer, so a burst of debug output cannot hold up a "hello:" ack.
+ *
+ * The transmit ISR sends whole lines: at the start of each line it picks
+ * the highest priority queue with anything in it, and it stays with that
+ * queue until the '\n' (unless that queue runs dry mid-line).
+ *
+ * Control output is never dropped; uart_putchar() waits for room, as
+ * before.  Telemetry and debug output are dropped a line at a time: if a
+ * line starts when its queue has less than TX_LINE_RESERVE bytes free, the
+ * whole line is discarded, and counted in the link statistics.
  *
- * Only uart_putchar manipulates "in" and only uart_xmitchar manipulates "out".
+ * With "crc: on", txDequeue() adds the CRC trailer to each line (see
+ * tjs_crc.h).  Each queue keeps its own CRC state, since the ISR may
+ * switch queues mid-line; a queue picks up a change to the setting at its
+ * next line.
  *
- * uart_xmitchar is largely driven by xxx interrupts.  uart_putchar briefly
- * locks out interrupts so that uart_xmitchar doesn't empty the buffer ...
+ * Lines are queued with a bare '\n'; txDequeue() sends the "\r\n" that
+ * terminal programs expect (after the CRC trailer, if any).
  *
- * The buffer is a circular buffer.  It is empty when in = out;
- * it is full when in + 1 mod XMIT_BUFER_SIZE = out.
+ * A command reply can be built in place: uart_reserve() returns the
+ * free space after "in" in the control queue, if enough of it is
+ * contiguous, and uart_commit() queues the reply by moving "in" past it.
+ * (An empty control queue starts again at the front, so there usually is
+ * room.)
+ *
+ * Binary records (tjs_record.h) are queued whole, between lines, by
+ * uart_write_record() or uart_commit().  txDequeue() recognizes one by the top bit of its
+ * first byte, and sends its RECORD_LENGTH bytes as they are: a '\n' in a
+ * record does not end a line, and gets no CRC trailer.
+ *
+ * Only uart_putchar(), uart_write_record() and uart_commit() move a
+ * queue's "in" (and uart_reserve() rewinds an empty control queue); only
+ * txDequeue() moves "out".
+ * Each queue is empty when in = out, and full when in + 1 = out (mod size).
  */
- 
-static unsigned char xmitBuffer[XMIT_BUFER_SIZE] = {0};    // transmit buffer
-volatile int in = 0;                    // next buffer slot to be filled
-volatile int out = 0;                   // next buffer slot to be removed
+
+#define TX_LINE_RESERVE 32              // free space needed to start a droppable line
+
+typedef struct {
+	unsigned char *buffer;
+	uint8_t size;
+	volatile uint8_t in;                // next slot to be filled
+	volatile uint8_t out;               // next slot to be sent
+	uint8_t lineStart;                  // last char queued was '\n'
+	uint8_t dropping;                   // discarding the rest of this line
+	crcTx crc;                          // CRC trailer state of line being sent
+} txQueue;
+
+static unsigned char txControlBuffer[112];    // room for a REPLY_MAX reply (tjs_reply.h)
+static unsigned char txTelemetryBuffer[64];
+static unsigned char txDebugBuffer[96];
+
+static txQueue txQueues[UART_CLASSES] = {
+	{txControlBuffer, sizeof(txControlBuffer), 0, 0, 1, 0, {0, CRC_TX_START, CRC_INIT}},
+	{txTelemetryBuffer, sizeof(txTelemetryBuffer), 0, 0, 1, 0, {0, CRC_TX_START, CRC_INIT}},
+	{txDebugBuffer, sizeof(txDebugBuffer), 0, 0, 1, 0, {0, CRC_TX_START, CRC_INIT}}
+};
+
+static uint8_t txClass = UART_CONTROL;  // class of uart_putchar() output
+static uint8_t txSending = UART_CONTROL;    // queue the ISR is sending from
+static uint8_t txLineStart = 1;         // ISR is at the start of a line
+static uint8_t txRecordLeft = 0;        // bytes of binary record still to send
+static uint8_t txCrSent = 0;            // '\r' sent ahead of the '\n' to send next
 
 static int spinLoops = 0;               // count of uart_putchar waits
 
 
 
+/* txUsed - bytes in queue q.
+ */
+
+static inline uint8_t txUsed(txQueue *q) {
+	return (q->in + q->size - q->out) % q->size;
+}
+
+
+
+/* txDequeue - take the next char to transmit, or return -1 if all the
+ * queues are empty.  Called with interrupts disabled.
+ */
+
+static int txDequeue(void) {
+
+	txQueue *q = &txQueues[txSending];
+
+	if ((txRecordLeft == 0) && (txLineStart || (q->in == q->out))) {
+		uint8_t c;
+		for (c = 0; c < UART_CLASSES; c++) {
+			if (txQueues[c].in != txQueues[c].out) break;
+		}
+		if (c == UART_CLASSES) return -1;
+		txSending = c;
+		q = &txQueues[c];
+	}
+
+	if ((txRecordLeft > 0) || (q->buffer[q->out] & RECORD_MARK)) {
+		unsigned char ch = q->buffer[q->out];
+		q->out = (q->out + 1) % q->size;
+		if (txRecordLeft == 0) txRecordLeft = RECORD_LENGTH;
+		txRecordLeft--;
+		txLineStart = (txRecordLeft == 0);
+		linkStatistics[INTERFACE_ASYNC].bytesOut++;
+		return ch;
+	}
+
+	uint8_t take;
+	if (q->crc.state == CRC_TX_START) q->crc.enabled = crcTxState[INTERFACE_ASYNC].enabled;
+	unsigned char ch = crcTxNext(&q->crc, q->buffer[q->out], &take);
+	if (take && (ch == '\n') && !txCrSent) {
+		ch = '\r';                      // "\r\n": '\n' again next time
+		take = 0;
+		txCrSent = 1;
+	} else if (take) {
+		txCrSent = 0;
+	}
+	if (take) q->out = (q->out + 1) % q->size;    // else a trailer byte, or '\r'
+	txLineStart = take && (ch == '\n');
+	linkStatistics[INTERFACE_ASYNC].bytesOut++;
+	return ch;
+}
+
+
+
+/* uart_set_class() - set the priority class of subsequent output, and
+ * return the previous class, so it can be restored.
+ */
+
+uint8_t uart_set_class(uint8_t c) {
+
+	uint8_t old = txClass;
+
+	if (c < UART_CLASSES) txClass = c;
+	return old;
+}
+
+
+
 /* uart_putchar() - write one character to USART port.
  */
  
 int uart_putchar(char c, FILE *stream) {
     
-    /* insert a '\r' before every '\n'.
-     * Many terminal programs expect this.  However, this behavior breaks
-     * binary transfers.  It would be nice if this behavior were controlled
-     * by a run-time flag.
-     */
+    /* Note: txDequeue() sends a '\r' before every '\n'. */
 
-    if (c == '\n') uart_putchar('\r', stream);    // insert \r prior to \n
-    
-    while (((in+1) % XMIT_BUFER_SIZE) == out) {   // spin waiting for buffer to empty
-	    toggleRedLED();
+    txQueue *q = &txQueues[txClass];
+
+    /* Droppable output: decide at the start of each line. */
+
+    if (txClass != UART_CONTROL) {
+        if (q->lineStart) {
+            q->dropping = (q->size - 1 - txUsed(q) < TX_LINE_RESERVE);
+            if (q->dropping) linkStatistics[INTERFACE_ASYNC].txDropped++;
+        }
+        q->lineStart = (c == '\n');
+        if (q->dropping) return 0;
+    }
+
+    while (((q->in + 1) % q->size) == q->out) {   // spin waiting for room
+        spinLoops++;
+        ledsFlash(LED_RED);             // output waiting (tjs_leds.h)
+        UCSR1B = UCSR1B | (1 << UDRIE1);    // make sure the ISR is draining
+        sei();                          // FIXME: as below; can't wait with interrupts off
 	}
-//    offRedLED();
 	
-    /* Insert character in buffer. */
+    /* Insert character in queue. */
     
     int sreg = SREG;                    // save interrupt state
     cli();
-    xmitBuffer[in] = c;                 // insert character in circular buffer
-    in = (in + 1) % XMIT_BUFER_SIZE;    // update in
-    
-    /* ****** DEBUG ****** */
-    /* Print without interrupts. */
-//	while (in != out) {                 // while buffer not empty
-//		while (!(UCSR1A & (1 << UDRE1)));   // wait for Data Register to be empty
-//		UDR1 = xmitBuffer[out];
-//		out = (out + 1) % XMIT_BUFER_SIZE;
-//	}
-//    while (!(UCSR1A & (1 << UDRE1)));   // wait for Data Register to be empty
-//
-//    SREG = sreg;
-//    sei();
-//	return 0;			
-		
-//  while (!(UCSR1A & (1 << UDRE1)));   // wait for Data Register to be empty
-//  if (in != out) {                    // if buffer not empty (should always be the case)
-//      UDR1 = xmitBuffer[out];
-//      out = (out + 1) % XMIT_BUFER_SIZE;
-//  }
-//  SREG = sreg;
-//  sei();
-//  return 0;
-    /* ****** END DEBUG ****** */
+    q->buffer[q->in] = c;               // insert character in circular buffer
+    q->in = (q->in + 1) % q->size;      // update in
+    statsHighWater(&linkStatistics[INTERFACE_ASYNC].txHighWater, txUsed(q));
     
     /* If Data Register empty, write next character to USART Data Register. */
     
     if (UCSR1A & (1 << UDRE1)) {        // if Data Register empty
-        
-        if (in != out) {                // if buffer not empty (should always be the case)
-            UDR1 = xmitBuffer[out];
-            out = (out + 1) % XMIT_BUFER_SIZE;
-        }
+        int ch = txDequeue();
+        if (ch >= 0) UDR1 = ch;
     }
     
-    /* if buffer not empty, ensure interrupt on Data Register empty */
-    
-    if (in != out) {
-        UCSR1B = UCSR1B | (1 << UDRIE1);    // enable interrupt on Data Register empty  
-    }
-	
-    UCSR1B = UCSR1B | (1 << UDRIE1);    // ****** enable interrupt on Data Register empty  
+    UCSR1B = UCSR1B | (1 << UDRIE1);    // enable interrupt on Data Register empty  
     
     SREG = sreg;                        // restore previous interrupt state
     sei();                              // FIXME: ******
@@ -252,11 +348,105 @@ int uart_putchar(char c, FILE *stream) {
 
 
 
+/* uart_write_record() - queue binary records (see tjs_record.h) in the
+ * current class.  They are queued whole, or, if telemetry or debug, not
+ * at all (counted as a dropped line).  Returns 0, or -1 if dropped.
+ * Called between lines.
+ */
+
+int uart_write_record(const uint8_t *record, uint8_t length) {
+
+    txQueue *q = &txQueues[txClass];
+
+    if (txClass != UART_CONTROL) {
+        if (q->size - 1 - txUsed(q) < length) {
+            linkStatistics[INTERFACE_ASYNC].txDropped++;
+            return -1;
+        }
+    } else {
+        while (q->size - 1 - txUsed(q) < length) {    // spin waiting for room
+            spinLoops++;
+            UCSR1B = UCSR1B | (1 << UDRIE1);    // make sure the ISR is draining
+            sei();
+        }
+    }
+
+    int sreg = SREG;                    // save interrupt state
+    cli();
+    uint8_t i;
+    for (i = 0; i < length; i++) {      // whole records, so the ISR never waits mid-record
+        q->buffer[q->in] = record[i];
+        q->in = (q->in + 1) % q->size;
+    }
+    statsHighWater(&linkStatistics[INTERFACE_ASYNC].txHighWater, txUsed(q));
+
+    if (UCSR1A & (1 << UDRE1)) {        // if Data Register empty
+        int ch = txDequeue();
+        if (ch >= 0) UDR1 = ch;
+    }
+    UCSR1B = UCSR1B | (1 << UDRIE1);    // enable interrupt on Data Register empty
+    SREG = sreg;                        // restore previous interrupt state
+    return 0;
+}
+
+
+
+/* uart_reserve() - return where a command reply of up to need bytes can
+ * be built in the control queue, to be queued by uart_commit(), or NULL
+ * if the free space is not contiguous (or the queue is too full).  The
+ * space is only reserved until the next output.
+ */
+
+char* uart_reserve(uint8_t need) {
+
+    txQueue *q = &txQueues[UART_CONTROL];
+    uint8_t room;
+
+    int sreg = SREG;                    // save interrupt state
+    cli();
+    if (q->in == q->out) q->in = q->out = 0;    // empty: start at the front
+    if (q->out > q->in) room = q->out - q->in - 1;
+    else room = q->size - q->in - (q->out == 0);
+    SREG = sreg;
+    return (room >= need) ? (char *)&q->buffer[q->in] : NULL;
+}
+
+
+
+/* uart_commit() - queue the length bytes built at uart_reserve()'s
+ * reply, with one update of "in".
+ */
+
+void uart_commit(uint8_t length) {
+
+    txQueue *q = &txQueues[UART_CONTROL];
+
+    int sreg = SREG;                    // save interrupt state
+    cli();
+    q->in = (q->in + length) % q->size;
+    statsHighWater(&linkStatistics[INTERFACE_ASYNC].txHighWater, txUsed(q));
+
+    if (UCSR1A & (1 << UDRE1)) {        // if Data Register empty
+        int ch = txDequeue();
+        if (ch >= 0) UDR1 = ch;
+    }
+    UCSR1B = UCSR1B | (1 << UDRIE1);    // enable interrupt on Data Register empty
+    SREG = sreg;                        // restore previous interrupt state
+}
+
+
+
 /* uart_output_buffer_empty() - return true if output buffer is empty.
  */
  
 volatile int uart_output_buffer_empty() {
-	return !(in == out);
+
+	uint8_t c;
+
+	for (c = 0; c < UART_CLASSES; c++) {
+		if (txQueues[c].in != txQueues[c].out) return 1;
+	}
+	return 0;
 }
 
 
@@ -264,14 +454,14 @@ volatile int uart_output_buffer_empty() {
 /* USART Data Register Empty ISR.
  *
  * This function processes USASRT Data Register Empty interrupts.
- * If the buffer is not empty, the next char from the buffer is
+ * If a queue is not empty, the next char (see txDequeue()) is
  * placed in the Data Register.  USART Data Register Empty interrupts
  * are left enabled (even if this might be the last char in the buffer.
  * This might result in an extra interrupt after the last char 
  * transmitted, but it *might* close a timing window.  I need to look
  * at this more.
  *
- * If the buffer is empty, USART Data Register Empty interrupts are
+ * If the queues are empty, USART Data Register Empty interrupts are
  * disabled.  
  *
  */
@@ -285,20 +475,18 @@ volatile int uart_output_buffer_empty() {
 
 ISR(USART1_UDRE_vect) {
 
-    /* Indicate that ISR(USART_UDRE__vect) caught USART_UDRE interrupt. */
+    ISR_STATS_ENTER();
 
-//    onYellowLED();    
-    
     /* Move next char to USART Data Register.  If last char, disable nable
      *  USART_UDRE interrupt. */
     
-    if (in != out) {                    // if buffer not empty
-        UDR1 = xmitBuffer[out];         // put next char in Data Register
-        out = (out + 1) % XMIT_BUFER_SIZE;    // update out
+    int ch = txDequeue();
+    if (ch >= 0) {                      // if a queue is not empty
+        UDR1 = ch;                      // put next char in Data Register
     } else {
         UCSR1B = UCSR1B & ~(1 << UDRIE1);    // disable interrupt on Data Register empty
     }
-//	offYellowLED();
+    ISR_STATS_EXIT(INTERFACE_ASYNC);
 }
 
 
@@ -307,17 +495,14 @@ ISR(USART1_UDRE_vect) {
  */
  
 waitOutputComplete() {
-	while (in != out) {                 // wait for output buffer to empty
+	while (uart_output_buffer_empty()) {    // wait for all queues to empty
 		_delay_ms(1);
-		    if (UCSR1A & (1 << UDRE1)) {        // if Data Register empty
-        cli();        
-        if (in != out) {                // if buffer not empty (should always be the case)
-            UDR1 = xmitBuffer[out];
-            out = (out + 1) % XMIT_BUFER_SIZE;
-        }
-		sei();
-    }
-
+		if (UCSR1A & (1 << UDRE1)) {    // if Data Register empty
+			cli();
+			int ch = txDequeue();
+			if (ch >= 0) UDR1 = ch;
+			sei();
+		}
         UCSR1B = UCSR1B | (1 << UDRIE1);    // enable interrupt on Data Register empty  
 	}
 }
@@ -338,6 +523,8 @@ int uart_getchar(FILE *stream) {
 
 
 
+#if CONFIG_ASYNC
+
 /* USART Receive Data Ready ISR.
  * This code is copied pretty directly from:
  * https://github.umn.edu/course-material/repo-rtes-public/blob/master/ExampleCode/basic-serial/main.c
@@ -347,22 +534,40 @@ int uart_getchar(FILE *stream) {
 
 ISR(USART1_RX_vect) {
 
+    ISR_STATS_ENTER();
+    linkStats *stats = &linkStatistics[INTERFACE_ASYNC];
+
+    if (UCSR1A & ((1 << FE1) | (1 << DOR1))) stats->errors++;    // framing error or overrun
     uint8_t ch = UDR1;                  // fetch character
+    stats->bytesIn++;
+
+	cmdQueue *q = &cmdQueues[INTERFACE_ASYNC];
+	cmdParser *p = &cmdParsers[INTERFACE_ASYNC];
+	crcRx *crc = &crcRxState[INTERFACE_ASYNC];
 
-	if ((recv_buffer_ptr >= RECEIVE_BUFFER_LENGTH-1) && (ch != '\r')) return;    // ignore excess chars
-	
 	/* Check for command termination. */
 	
-	if (ch == '\r') {                   // already terminated string
-		user_command_ready = 1;
+	if (ch == '\r') {                   // end of command: queue it
+		if (!crcRxEnd(crc)) {
+			parseDropFrame(p, q);
+			stats->crcErrors++;         // bad or missing CRC trailer
+		} else if (parseEndFrame(p, q) != NULL) {
+			stats->commands++;
+			postEventFromIsr(EVENT_ASYNC_COMMAND);
+		} else {
+			stats->errors++;            // queue full, or command too long
+		}
 	}
 
     /* process delete char. */
 	
     else if (ch == 8) {
-        if (recv_buffer_ptr >= 1)
-            --recv_buffer_ptr;
-        recv_buffer[recv_buffer_ptr] = 0;
+        parseUnputChar(p, q);
+    }
+
+    /* CRC trailer: checked, not stored. */
+
+    else if (crcRxTrailer(crc, ch)) {
     }
 
     //Only store alphanumeric symbols, space, the dot, plus and minus sign
@@ -371,53 +576,92 @@ ISR(USART1_RX_vect) {
         ((ch >= '0') && (ch <= '9')) ||
         ((ch >= 'A') && (ch <= 'Z')) ||
         ((ch >= 'a') && (ch <= 'z')) ) {
-        recv_buffer[recv_buffer_ptr++] = ch;
-		recv_buffer[recv_buffer_ptr] = '\0';
+        crcRxAdd(crc, ch);
+        parsePutChar(p, q, ch);
+		statsHighWater(&stats->rxHighWater, cmdqUsed(q));
     }
+    ISR_STATS_EXIT(INTERFACE_ASYNC);
 }
 
+#endif
+
 
 
 	typedef struct {
-		char *cmd;
-		int (*cmdProc)(char *);
+		PGM_P cmd;						// command name, in flash
+		char* (*cmdProc)(char *);
+		uint8_t quiet;					// not echoed (see registerQuietCommand())
     } commandTable;
 	
-	commandTable cmdTable[25];
+	commandTable cmdTable[PARSE_COMMANDS];
 	 
 	int commandMax = 0;
 
 	
-/* processUserCommand - process user command input.
+/* processUserCommand - process user command input: a frame of length
+ * bytes, already split into tokens by the receive ISR, and the index of
+ * its command (see tjs_parse.h).
  */
 
-char* processUserCommand(char* buffer) {
-	
-	char* token;
-	token = strtok(buffer, " ");
-
-    int i;
-	int found = 0;
-    for (i = 0; i < commandMax; i++) {
-	    if (strcmp(token, cmdTable[i].cmd) == 0) {
-			return cmdTable[i].cmdProc(buffer);
-		    found = 1;					// uhhh... never executed
-		    break;						// never executed...
-        }			
-	}
-	
-	if (!found) {						// FIXME: no conditional needed
-		return "# Command not found\n";
+char* processUserCommand(char* command, uint8_t length, uint8_t index) {
+
+	parseArgs(command, length);
+	if ((index < commandMax) && (strcmp_P(command, cmdTable[index].cmd) == 0)) {
+		return cmdTable[index].cmdProc(command);
 	}
+	return progmemReply(PSTR("# Command not found\n"));
 }
 
 
 
 /* registerUserCommand - register a user command for command processing. 
+ * The command name must be in flash, e.g., registerUserCommand(PSTR("x:"), f).
+ * Returns -1 if the command cannot be added.
  */
  
-int registerUserCommand(char* command, char* (*commandProcessor)(char *)) {
+int registerUserCommand(PGM_P command, char* (*commandProcessor)(char *)) {
+	if (parseRegister(commandMax, command) != 0) return -1;    // table full, or hash taken
 	cmdTable[commandMax].cmd = command;
 	cmdTable[commandMax++].cmdProc = commandProcessor;
 	return 0;
 }
+
+
+
+/* registerQuietCommand - register a user command that is not echoed
+ * ("rx: ...") on the async interface, e.g., an acknowledgement that gets
+ * no reply, so that it costs no output at all.
+ */
+
+int registerQuietCommand(PGM_P command, char* (*commandProcessor)(char *)) {
+	if (registerUserCommand(command, commandProcessor) != 0) return -1;
+	cmdTable[commandMax - 1].quiet = 1;
+	return 0;
+}
+
+
+
+/* userCommandQuiet - return 1 if command index (see tjs_parse.h) is not
+ * to be echoed.
+ */
+
+uint8_t userCommandQuiet(uint8_t index) {
+	return (index < commandMax) && cmdTable[index].quiet;
+}
+
+
+
+/* progmemReply - copy a constant reply string out of flash.
+ * Command processors return a char* in SRAM; this lets them keep their
+ * fixed replies (e.g., "nack:\n") in flash.  The reply is copied straight
+ * into the reply slot (see tjs_reply.h).
+ */
+
+char* progmemReply(PGM_P reply) {
+
+	const uint8_t size = 24;            // longest constant reply, plus null
+	char *string = replySlot(size);
+
+	strlcpy_P(string, reply, size);
+	return string;
+}
@@ -10,16 +10,35 @@
 
 //#define RECEIVE_BUFFER_LENGTH 50
 
+#include <stdint.h>
+
+#include "tjs_progmem.h"
+
+/* Output priority classes.  The transmit ISR drains higher priority
+ * (lower numbered) output first, a line at a time; telemetry and debug
+ * lines are dropped if their queue is nearly full. */
+
+#define UART_CONTROL 0                  // command replies (never dropped)
+#define UART_TELEMETRY 1                // periodic and pushed readings
+#define UART_DEBUG 2                    // traces and debug messages
+#define UART_CLASSES 3
+
+uint8_t uart_set_class(uint8_t);        // set class of output, return old class
 int uart_putchar(char c, FILE *stream); // write a character to USART
+int uart_write_record(const uint8_t *, uint8_t length);     // write binary records (see tjs_record.h); -1 if dropped
+char* uart_reserve(uint8_t need);       // where to build a reply in place, or NULL
+void uart_commit(uint8_t length);       // queue reply built in place
 int uart_getchar(FILE *stream);         // Get a character from USART
 
 void uart_init(void);                   // Initial USART
 
-static FILE mystdout = FDEV_SETUP_STREAM(uart_putchar, NULL, _FDEV_SETUP_WRITE);
-static FILE mystdin = FDEV_SETUP_STREAM(NULL, uart_getchar, _FDEV_SETUP_READ);
+extern FILE mystdout;                   // stdout stream (defined in simpleSerial.c)
+extern FILE mystdin;                    // stdin stream (defined in simpleSerial.c)
 
 int uart_output_buffer_empty();         // check if output buffer is empty
 void waitOutputComplete();              // wait for output to finish
 
-char* processUserCommand(char*);   		// process command from interface
-int registerUserCommand(char*, char* (*cmdProc)(char *));    // register a user command
+char* processUserCommand(char*, uint8_t length, uint8_t index);    // process command from interface
+int registerUserCommand(PGM_P, char* (*cmdProc)(char *));    // register a user command (name in flash)
+int registerQuietCommand(PGM_P, char* (*cmdProc)(char *));    // same, not echoed on async
+uint8_t userCommandQuiet(uint8_t index);    // command is not echoed
@@ -9,19 +9,27 @@
  * Copyright (C) Timothy J. Salo, 2018.
  */
  
+#include <ctype.h>
+#include <stdio.h>
 #include <string.h>
 
-#include <util/twi.h>
-#include <avr/io.h>
-#include <avr/interrupt.h>
-
+#include "simpleSerial.h"
+#include "tjs_cmdq.h"
+#include "tjs_config.h"
+#include "tjs_crc.h"
+#include "tjs_hal.h"
 #include "tjs_leds.h"
+#include "tjs_linkstats.h"
+#include "tjs_parse.h"
+#include "tjs_sched.h"
 #include "tjsI2cSlave.h"
 
+#if CONFIG_I2C                          // whole driver (tjs_config.h)
+
 /* Enable / Disable debug printing. */
 
 #define RX_DEBUG 0
-#define TX_DEBUG 1
+#define TX_DEBUG CONFIG_DEBUG
 
 
 /* State of I2C/TWI link. */
@@ -29,20 +37,13 @@
 enum State {IDLE, HELLO_SENT, LINK_ESTABLISHED, SEND_SENT, LINK_ACTIVE};
 enum State state;
 
-/* I2C receive processing. */
-
-#define I2C_RX_BUFFER_LENGTH 100
-
-volatile unsigned char i2cRxBuffer[I2C_RX_BUFFER_LENGTH];  // buffer containing I2C command
-volatile int i2cRxBufferp = 0;                // pointer into i2cRxBuffer
-volatile unsigned int i2cCommandReady = 0;    // set if i2c command received
-
 /* I2C transmit processing. */
 
-#define I2C_TX_BUFFER_LENGTH 100
-
-volatile unsigned char i2cTxBuffer[I2C_TX_BUFFER_LENGTH];  // buffer containing I2C command
+static unsigned char i2cTxBuffers[2][I2C_TX_BUFFER_LENGTH];   // reply being sent, and the next
+volatile unsigned char *volatile i2cTxBuffer = i2cTxBuffers[0];    // reply being sent
 volatile int i2cTxBufferp = 0;                 // pointer into i2cTxBuffer
+volatile int i2cTxLength = 0;           // bytes in i2cTxBuffer
+volatile uint8_t i2cTxBinary = 0;       // reply is binary (no CRC trailer)
 volatile int i2cTxBufferLock = 0;		// lock on tx buffer
 volatile int i2cTransmitSensorData = 0;	// to send temperature sensor readings
 
@@ -50,7 +51,7 @@ volatile int i2cTransmitSensorData = 0;	// to send temperature sensor readings
 
 extern unsigned char debugBuffer[500];
 extern int debugCommandReady;
-char hex[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+const char hex[] PROGMEM = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
 
 extern char tempString[];				// Latest temp reading "temp: nn.n"
 
@@ -96,11 +97,111 @@ void tjsI2cStop(void) {
 
 
 
+/* i2cReceive - take a received byte from TWDR and add it to the command
+ * being received; at '\n', check the CRC trailer, if any, and queue the
+ * command (see tjs_cmdq.h and tjs_crc.h).  Returns the byte.
+ */
+
+static inline unsigned char i2cReceive(linkStats *stats) {
+
+	cmdQueue *q = &cmdQueues[INTERFACE_I2C];
+	cmdParser *p = &cmdParsers[INTERFACE_I2C];
+	crcRx *crc = &crcRxState[INTERFACE_I2C];
+	unsigned char ch = TWDR;
+
+	stats->bytesIn++;
+	if (ch == '\n') {
+		if (!crcRxEnd(crc)) {
+			parseDropFrame(p, q);
+			stats->crcErrors++;         // bad or missing CRC trailer
+		} else if (parseEndFrame(p, q) != NULL) {
+			stats->commands++;
+			postEventFromIsr(EVENT_I2C_COMMAND);
+		} else {
+			stats->errors++;            // queue full, or command too long
+		}
+	} else if (!crcRxTrailer(crc, ch)) {
+		crcRxAdd(crc, ch);
+		parsePutChar(p, q, ch);
+		statsHighWater(&stats->rxHighWater, cmdqUsed(q));
+	}
+	return ch;
+}
+
+
+
+/* i2cReserve - return the reply buffer that is not being sent
+ * (I2C_TX_BUFFER_LENGTH bytes), where the next reply can be built while
+ * the master may still be reading the last one.
+ */
+
+char* i2cReserve(void) {
+	return (char *)((i2cTxBuffer == i2cTxBuffers[0]) ? i2cTxBuffers[1] : i2cTxBuffers[0]);
+}
+
+
+
+/* i2cSetReply - make reply (length bytes; binary, or text) the reply to
+ * the next read.  A reply built in i2cReserve()'s buffer is not copied:
+ * the buffers just change places.
+ */
+
+void i2cSetReply(const char *reply, uint8_t length, uint8_t binary) {
+
+	char *next = i2cReserve();
+
+	if (length > I2C_TX_BUFFER_LENGTH) length = I2C_TX_BUFFER_LENGTH;
+	if (reply != next) memcpy(next, reply, length);
+
+	unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	i2cTxBuffer = (unsigned char *)next;
+	i2cTxLength = length;
+	i2cTxBufferp = 0;
+	i2cTxBinary = binary;
+	crcTxReset(&crcTxState[INTERFACE_I2C]);
+	SREG = sreg;
+}
+
+
+
+/* i2cTransmit - put the next byte of the reply in TWDR (a NUL after the
+ * end), with the CRC trailer, if any, ahead of the '\n' of a text reply
+ * (see tjs_crc.h).  Returns the byte.
+ */
+
+static inline unsigned char i2cTransmit(linkStats *stats) {
+
+	uint8_t take = 1;
+	uint8_t more = (i2cTxBufferp < i2cTxLength);
+	unsigned char ch = more ? i2cTxBuffer[i2cTxBufferp] : 0;
+
+	if (!i2cTxBinary) {
+		ch = crcTxNext(&crcTxState[INTERFACE_I2C], ch, &take);
+		if (!take) more = 1;            // trailer byte
+	}
+	TWDR = ch;
+	if (more) {
+		if (take) i2cTxBufferp++;
+		stats->bytesOut++;
+		TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEA) | (1<<TWEN);
+	} else {
+		TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEN);
+	}
+	return ch;
+}
+
+
+
 /* ISR(TWI_vect) - process TWI (I2C) interrupts.
  */
  
 ISR(TWI_vect) {
 
+    ISR_STATS_ENTER();
+    linkStats *stats = &linkStatistics[INTERFACE_I2C];
+    ledsFlash(LED_YELLOW);              // bus activity (tjs_leds.h)
+
     /* Process based on TWI status.
 	 *
      * Note:  most comments directly from AVR datasheet and twi.h.
@@ -109,6 +210,8 @@ ISR(TWI_vect) {
     switch(TW_STATUS) {					// TWSR, status bits only
 		
 		unsigned char ch;				// used by debug
+		unsigned char rxCh;				// byte received
+		unsigned char txCh;				// byte transmitted
 		char chars[8];					// "ff (c)\n\0"
 		
 		/* Slave Receive - Receive data byte from master (and ACK returned).
@@ -118,38 +221,32 @@ ISR(TWI_vect) {
 		char tempBuffer[50];
 
         case TW_SR_DATA_ACK:
-			displayOctalDigit(1);
-			if (i2cRxBufferp == I2C_RX_BUFFER_LENGTH) i2cRxBufferp--;	// avoid buffer overrun
-            i2cRxBuffer[i2cRxBufferp++] = TWDR;
-			i2cRxBuffer[i2cRxBufferp] = '\0';
-			if (i2cRxBuffer[i2cRxBufferp-1] == 0x0a) {    // if '\n'
-				i2cRxBuffer[--i2cRxBufferp] = '\0';		// eat '\n'
-				i2cCommandReady = 1;
-			}
+			rxCh = i2cReceive(stats);
             TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEA) | (1<<TWEN);
 			
 			/* Debug */
 			
 			if (RX_DEBUG) {
-				if (i2cCommandReady != 1) {
-					ch = toascii(i2cRxBuffer[i2cRxBufferp-1]);
+				if (rxCh != '\n') {
+					ch = toascii(rxCh);
 					if (iscntrl(ch)) ch = '.';
-					if (i2cRxBufferp == 1) {
-						strcpy(debugBuffer, "\nTW_SR_DATA_ACK: ");
+					if (cmdQueues[INTERFACE_I2C].length == 1) {
+						strcpy_P(debugBuffer, PSTR("\nTW_SR_DATA_ACK: "));
 					} else {
-						strlcat(debugBuffer, "TW_SR_DATA_ACK: ", 500);
+						strlcat_P(debugBuffer, PSTR("TW_SR_DATA_ACK: "), sizeof debugBuffer);
 					} 
-					chars[0] = hex[(i2cRxBuffer[i2cRxBufferp-1] >> 4) & 0xf];
-					chars[1] = hex[i2cRxBuffer[i2cRxBufferp-1] & 0xf];
+					chars[0] = pgm_read_byte(&hex[(rxCh >> 4) & 0xf]);
+					chars[1] = pgm_read_byte(&hex[rxCh & 0xf]);
 					chars[2] = ' ';
 					chars[3] = '\'';
 					chars[4] = ch;
 					chars[5] = '\'';
 					chars[6] = '\n';
 					chars[7] = '\0';
-					strlcat(debugBuffer, chars, 500);
+					strlcat(debugBuffer, chars, sizeof debugBuffer);
 				} else {
 					debugCommandReady = 1;
+					postEventFromIsr(EVENT_DEBUG);
 				}
 			}
             break;
@@ -161,35 +258,29 @@ ISR(TWI_vect) {
 		 */
 		
         case TW_SR_DATA_NACK:
-			displayOctalDigit(2);
-			if (i2cRxBufferp == I2C_RX_BUFFER_LENGTH) i2cRxBufferp--;	// avoid buffer overrun
-            i2cRxBuffer[i2cRxBufferp++] = TWDR;
-			i2cRxBuffer[i2cRxBufferp] = '\0';
-			if (i2cRxBuffer[i2cRxBufferp-1] == 0x0a) {    // if '\n'
-				i2cRxBuffer[--i2cRxBufferp] = '\0';		// eat '\n'
-				i2cCommandReady = 1;
-			}
+			rxCh = i2cReceive(stats);
             TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEA) | (1<<TWEN);
 			if (RX_DEBUG) {
-				if (i2cCommandReady != 1) {
-					ch = toascii(i2cRxBuffer[i2cRxBufferp-1]);
+				if (rxCh != '\n') {
+					ch = toascii(rxCh);
 					if (iscntrl(ch)) ch = '.';
-					if (i2cRxBufferp == 1) {
-						strcpy(debugBuffer, "\nTW_SR_DATA_NACK: ");
+					if (cmdQueues[INTERFACE_I2C].length == 1) {
+						strcpy_P(debugBuffer, PSTR("\nTW_SR_DATA_NACK: "));
 					} else {
-						strlcat(debugBuffer, "TW_SR_DATA_NACK: ", 500);
+						strlcat_P(debugBuffer, PSTR("TW_SR_DATA_NACK: "), sizeof debugBuffer);
 					} 
-					chars[0] = hex[(i2cRxBuffer[i2cRxBufferp-1] >> 4) & 0xf];
-					chars[1] = hex[i2cRxBuffer[i2cRxBufferp-1] & 0xf];
+					chars[0] = pgm_read_byte(&hex[(rxCh >> 4) & 0xf]);
+					chars[1] = pgm_read_byte(&hex[rxCh & 0xf]);
 					chars[2] = ' ';
 					chars[3] = '\'';
 					chars[4] = ch;
 					chars[5] = '\'';
 					chars[6] = '\n';
 					chars[7] = '\0';
-					strlcat(debugBuffer, chars, 500);
+					strlcat(debugBuffer, chars, sizeof debugBuffer);
 				} else {
 					debugCommandReady = 1;
+					postEventFromIsr(EVENT_DEBUG);
 				}
 			}
             break;
@@ -200,31 +291,24 @@ ISR(TWI_vect) {
 		
         case TW_ST_SLA_ACK:
 		    // receive this..
-			displayOctalDigit(3);
-			if (i2cTxBuffer[i2cTxBufferp] != 0) {
-				TWDR = i2cTxBuffer[i2cTxBufferp++];    // transmit next byte
-				TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEA) | (1<<TWEN);
-			} else {
-				TWDR = 0;
-				TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEN);
-			}
+			txCh = i2cTransmit(stats);      // transmit next byte
 			if (TX_DEBUG) {
-				ch = toascii(i2cTxBuffer[i2cTxBufferp-1]);
+				ch = toascii(txCh);
 				if (iscntrl(ch)) ch = '.';
 				if (i2cTxBufferp == 1) {
-					strcpy(debugBuffer, "\nTW_ST_SLA_ACK: ");
+					strcpy_P(debugBuffer, PSTR("\nTW_ST_SLA_ACK: "));
 				} else {
-					strlcat(debugBuffer, "TW_ST_SLA_ACK: ", 500);
+					strlcat_P(debugBuffer, PSTR("TW_ST_SLA_ACK: "), sizeof debugBuffer);
 				} 
-				chars[0] = hex[(i2cTxBuffer[i2cTxBufferp-1] >> 4) & 0xf];
-				chars[1] = hex[i2cTxBuffer[i2cTxBufferp-1] & 0xf];
+				chars[0] = pgm_read_byte(&hex[(txCh >> 4) & 0xf]);
+				chars[1] = pgm_read_byte(&hex[txCh & 0xf]);
 				chars[2] = ' ';
 				chars[3] = '\'';
 				chars[4] = ch;
 				chars[5] = '\'';
 				chars[6] = '\n';
 				chars[7] = '\0';
-				strlcat(debugBuffer, chars, 500);
+				strlcat(debugBuffer, chars, sizeof debugBuffer);
 			}
 			break;
 	  
@@ -234,32 +318,26 @@ ISR(TWI_vect) {
 		
 		case TW_ST_DATA_ACK:
 		    // receive this...
-			displayOctalDigit(4);
-			if (i2cTxBuffer[i2cTxBufferp] != 0) {
-				TWDR = i2cTxBuffer[i2cTxBufferp++];    // transmit next byte
-				TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEA) | (1<<TWEN);
-			} else {
-				TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEN);
-				TWDR = 0;
-			}
+			txCh = i2cTransmit(stats);      // transmit next byte
 			if (TX_DEBUG) {
-				ch = toascii(i2cTxBuffer[i2cTxBufferp-1]);
+				ch = toascii(txCh);
 				if (iscntrl(ch)) ch = '.';
 				if (i2cTxBufferp == 1) {
-					strcpy(debugBuffer, "\nTW_ST_DATA_ACK: ");
+					strcpy_P(debugBuffer, PSTR("\nTW_ST_DATA_ACK: "));
 				} else {
-					strlcat(debugBuffer, "TW_ST_DATA_ACK: ", 500);
+					strlcat_P(debugBuffer, PSTR("TW_ST_DATA_ACK: "), sizeof debugBuffer);
 				} 
-				chars[0] = hex[(i2cTxBuffer[i2cTxBufferp-1] >> 4) & 0xf];
-				chars[1] = hex[i2cTxBuffer[i2cTxBufferp-1] & 0xf];
+				chars[0] = pgm_read_byte(&hex[(txCh >> 4) & 0xf]);
+				chars[1] = pgm_read_byte(&hex[txCh & 0xf]);
 				chars[2] = ' ';
 				chars[3] = '\'';
 				chars[4] = ch;
 				chars[5] = '\'';
 				chars[6] = '\n';
 				chars[7] = '\0';
-				strlcat(debugBuffer, chars, 500);
+				strlcat(debugBuffer, chars, sizeof debugBuffer);
 				debugCommandReady = 1;
+				postEventFromIsr(EVENT_DEBUG);
 			}
 			break;
 
@@ -269,14 +347,13 @@ ISR(TWI_vect) {
 		 
 		case TW_ST_DATA_NACK:
 		    // receive this...
-			displayOctalDigit(5);
 			TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEA) | (1<<TWEN);
 			if (TX_DEBUG) {
 				ch = toascii(i2cTxBuffer[i2cTxBufferp-1]);
 				if (iscntrl(ch)) ch = '.';
-				sprintf(tempBuffer, "TW_ST_DATA_NACK: %d \'%c\'\n",
+				sprintf_P(tempBuffer, PSTR("TW_ST_DATA_NACK: %d \'%c\'\n"),
 						i2cTxBufferp-1, ch);	// ****** debug ******
-				strcat(debugBuffer, tempBuffer);
+				strlcat(debugBuffer, tempBuffer, sizeof debugBuffer);
 			}
 			break;
 
@@ -287,15 +364,15 @@ ISR(TWI_vect) {
 
 		case TW_ST_LAST_DATA:
 		    // receive this...
-			displayOctalDigit(6);
 			TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEA) | (1<<TWEN);
 			if (TX_DEBUG) {
 				ch = toascii(i2cTxBuffer[i2cTxBufferp-1]);
 				if (iscntrl(ch)) ch = '.';
-				sprintf(tempBuffer, "TW_ST_LAST_DATA: %i \'%c\'\n",
+				sprintf_P(tempBuffer, PSTR("TW_ST_LAST_DATA: %i \'%c\'\n"),
 						i2cTxBufferp-1, ch);	// ****** debug ******
-				strcat(debugBuffer, tempBuffer);
+				strlcat(debugBuffer, tempBuffer, sizeof debugBuffer);
 				debugCommandReady = 1;
+				postEventFromIsr(EVENT_DEBUG);
 			}
 			break;
 			
@@ -305,6 +382,7 @@ ISR(TWI_vect) {
 		
 		case TW_BUS_ERROR:
 //			displayOctalDigit(7);
+			stats->errors++;
             TWCR = 0;
 			TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEA) | (1<<TWEN); 
 			break;
@@ -318,46 +396,17 @@ ISR(TWI_vect) {
 			TWCR = (1<<TWIE) | (1<<TWINT) | (1<<TWEA) | (1<<TWEN);
 			break;
 	}
-} 
-
 
-char* processI2cCommand() {
-
-    char* token;						// pointer to current token
-	char* pointer = i2cRxBuffer;		// used by strcmp_r
-	static char string[30];				// returned string
-
-	token = strtok_r(i2cRxBuffer, " ", &pointer);
-	
-	/* Process "hello: <seq> command. */
-	
-	if (strcmp(token, "hello:") == 0) {
-		
-		strlcpy(string, "ack:", sizeof(string));
-		char* token = strtok_r(NULL, " ", &pointer);    // grab possible <sequence>
-		if (token != NULL) {
-			strlcat(string, " ", sizeof(string));
-			strlcat(string, token, sizeof(string));
-		}
-		strlcat(string, "\n", sizeof(string));
-		return string;
-	}
+	ISR_STATS_EXIT(INTERFACE_I2C);
+} 
 
-	/* Process "send: temp" command. */
 
-	if (strcmp(token, "send:") == 0) {
-		token = strtok_r(NULL, " ", &pointer);
-		if ((token != NULL) & (strcmp(token, "temp") == 0)) {
-			return tempString;
-		} else {
-			return "nack:\n";
-		}
-	}
-	
-	if (strcmp(token, "$:") == 0) {
-		return NULL;
-	}
+/* processI2cCommand - process command received over I2C interface.
+ * Commands are shared with the other interfaces (see registerUserCommand()).
+ */
 
-	return "# Command not found\n";
-	
+char* processI2cCommand(char *command, uint8_t length, uint8_t index) {
+	return processUserCommand(command, length, index);
 }
+
+#endif
@@ -7,18 +7,21 @@
 #ifndef I2C_SLAVE_H
 #define I2C_SLAVE_H
 
-#include <avr/interrupt.h>
-#include <util/delay.h>
 #include <stdint.h>
 
-#define I2C_RX_BUFFER_LENGTH 50
-#define I2C_TX_BUFFER_LENGTH 50
+#include "tjs_hal.h"
+
+#define I2C_TX_BUFFER_LENGTH 100		// transmit buffer (each of two)
 
 void tjsI2cInit(uint8_t address);
 void tjsI2cSendBytes(void);
 
 void I2C_stop(void);
 
+char* processI2cCommand(char *, uint8_t length, uint8_t index);    // process received command, return reply
+char* i2cReserve(void);                 // buffer to build next reply in
+void i2cSetReply(const char *, uint8_t length, uint8_t binary);    // set reply to next read
+
 //void I2C_recv(uint8_t);
 void I2C_req();
 
@@ -5,18 +5,26 @@
  * Copyright (C) Timothy J. Salo, 2019.
  */
  
+#include <stdio.h>
 #include <string.h>
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-
+#include "simpleSerial.h"
+#include "tjs_cmdq.h"
+#include "tjs_config.h"
+#include "tjs_crc.h"
+#include "tjs_hal.h"
 #include "tjs_leds.h"
+#include "tjs_linkstats.h"
+#include "tjs_parse.h"
+#include "tjs_sched.h"
 #include "tjsSpiSlave.h"
 
+#if CONFIG_SPI                          // whole driver (tjs_config.h)
+
 /* Enable / Disable debug printing. */
 
-#define RX_DEBUG 1
-#define TX_DEBUG 1
+#define RX_DEBUG CONFIG_DEBUG
+#define TX_DEBUG CONFIG_DEBUG
 
 
 /* State of SPI link. */
@@ -24,20 +32,16 @@
 enum State {IDLE, HELLO_SENT, LINK_ESTABLISHED, SEND_SENT, LINK_ACTIVE};
 enum State state;
 
-/* SPI receive processing. */
-
-#define SPI_RX_BUFFER_LENGTH 100
-
-volatile unsigned char spiRxBuffer[SPI_RX_BUFFER_LENGTH];  // buffer containing SPI command
-volatile int spiRxBufferp = 0;                // pointer into spiRxBuffer
-volatile unsigned int spiCommandReady = 0;    // set if SPI command received
-
 /* SPI transmit processing. */
 
-#define SPI_TX_BUFFER_LENGTH 100
-
-volatile unsigned char spiTxBuffer[SPI_TX_BUFFER_LENGTH];  // buffer containing SPI command
+static unsigned char spiTxBuffers[2][SPI_TX_BUFFER_LENGTH];   // reply being sent, and the next
+volatile unsigned char *volatile spiTxBuffer = spiTxBuffers[0];    // reply being sent
 volatile int spiTxBufferp = 0;          // pointer into spiTxBuffer
+volatile int spiTxLength = 0;           // bytes in spiTxBuffer
+volatile uint8_t spiTxBinary = 0;       // reply is binary (no CRC trailer)
+static uint8_t spiTxCh = 0;             // byte loaded in SPDR for the next transfer
+static uint8_t spiTxTake = 1;           // spiTxCh is from spiTxBuffer (not a trailer)
+static uint8_t spiTxLive = 0;           // spiTxCh is part of the reply
 volatile int spiTxBufferLock = 0;		// lock on tx buffer
 volatile int spiTransmitSensorData = 0;	// to send temperature sensor readings
 
@@ -70,8 +74,7 @@ void tjsSpiInit() {
 	unsigned char ch1 = SPSR;
 	unsigned char ch2 = SPDR;
 	
-	spiTxBufferp = 0;					// initialize receive buffer next in
-	spiRxBufferp = 0;					// initialize receive buffer next in
+	spiTxBufferp = 0;					// initialize transmit buffer next out
 
 	SREG = sreg;						// restore interrupt state
 }
@@ -92,37 +95,129 @@ int count = 0;
 unsigned char chOld;
 unsigned char chNew;
 
+/* spiNext - set spiTxCh to the next byte of the reply (a NUL after the
+ * end), with the CRC trailer, if any, ahead of the '\n' of a text reply
+ * (see tjs_crc.h).  Called with interrupts disabled.
+ */
+
+static inline void spiNext(void) {
+
+	spiTxTake = 1;
+	spiTxLive = (spiTxBufferp < spiTxLength);
+	spiTxCh = spiTxLive ? spiTxBuffer[spiTxBufferp] : 0;
+	if (!spiTxBinary) {
+		spiTxCh = crcTxNext(&crcTxState[INTERFACE_SPI], spiTxCh, &spiTxTake);
+		if (!spiTxTake) spiTxLive = 1;  // trailer byte
+	}
+}
+
+
+
+/* spiReserve - return the reply buffer that is not being sent
+ * (SPI_TX_BUFFER_LENGTH bytes), where the next reply can be built while
+ * the master may still be reading the last one.
+ */
+
+char* spiReserve(void) {
+	return (char *)((spiTxBuffer == spiTxBuffers[0]) ? spiTxBuffers[1] : spiTxBuffers[0]);
+}
+
+
+
+/* spiSetReply - make reply (length bytes; binary, or text) the reply to
+ * the next read.  Its first byte is loaded into SPDR at once.  A reply
+ * built in spiReserve()'s buffer is not copied: the buffers just change
+ * places.
+ */
+
+void spiSetReply(const char *reply, uint8_t length, uint8_t binary) {
+
+	char *next = spiReserve();
+
+	if (length > SPI_TX_BUFFER_LENGTH) length = SPI_TX_BUFFER_LENGTH;
+	if (reply != next) memcpy(next, reply, length);
+
+	unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	spiTxBuffer = (unsigned char *)next;
+	spiTxLength = length;
+	spiTxBufferp = 0;
+	spiTxBinary = binary;
+	crcTxReset(&crcTxState[INTERFACE_SPI]);
+	spiNext();
+	SPDR = spiTxCh;
+	SREG = sreg;
+}
+
+
+
 /* ISR(SPI_STC_vect) - SPI Serial Transfer Complete interrupts.
+ *
+ * The master reads the reply by sending NULs.  A transfer in which the
+ * master sent a NUL took the byte in SPDR, so the next one is loaded;
+ * otherwise (the master is sending a command) the same byte is loaded
+ * again.
  */
  
 ISR(SPI_STC_vect) {
+
+	ISR_STATS_ENTER();
+	linkStats *stats = &linkStatistics[INTERFACE_SPI];
+
 //	SPDR = 0xAA;
 //	while(!(SPSR & (1 << SPIF)));   	// wait for data to be ready
 //	enableYellowLED();
-	toggleYellowLED();
+	ledsFlash(LED_YELLOW);              // bus activity (tjs_leds.h)
 
-	if (spiRxBufferp == SPI_RX_BUFFER_LENGTH) spiRxBufferp--;	// avoid buffer overrun
-	
-	if (SPDR == 0) return;
-	
-    spiRxBuffer[spiRxBufferp++] = SPDR;
-	spiRxBuffer[spiRxBufferp] = '\0';
-			if (spiRxBuffer[spiRxBufferp-1] == 0x0a) {    // if '\n'
-				spiRxBuffer[--spiRxBufferp] = '\0';		// eat '\n'
-				spiCommandReady = 1;
-				strcpy(debugBuffer, spiRxBuffer);
-				debugCommandReady = 1;
-				spiRxBufferp = 0;
-			}
-			if (spiRxBufferp >= 20) {
-				spiCommandReady = 1;
-				strcpy(debugBuffer, spiRxBuffer);
+	stats->bytesIn++;
+	unsigned char ch = SPDR;
+
+	if (ch == 0) {                      // master read spiTxCh
+		if (spiTxLive) {
+			stats->bytesOut++;
+			if (spiTxTake) spiTxBufferp++;
+		}
+		spiNext();
+	}
+	SPDR = spiTxCh;
+	if (ch == 0) {
+		ISR_STATS_EXIT(INTERFACE_SPI);
+		return;
+	}
+
+	/* Queue the command at '\n'.  Commands longer than the frame buffer
+	 * are dropped by cmdqPutChar(), not cut; CRC trailers are checked,
+	 * and not stored. */
+
+	cmdQueue *q = &cmdQueues[INTERFACE_SPI];
+	cmdParser *p = &cmdParsers[INTERFACE_SPI];
+	crcRx *crc = &crcRxState[INTERFACE_SPI];
+	if ((ch != '\n') && !crcRxTrailer(crc, ch)) {
+		crcRxAdd(crc, ch);
+		parsePutChar(p, q, ch);
+		statsHighWater(&stats->rxHighWater, cmdqUsed(q));
+	}
+	if (ch == '\n') {
+		char *frame;
+		if (!crcRxEnd(crc)) {
+			parseDropFrame(p, q);
+			stats->crcErrors++;         // bad or missing CRC trailer
+		} else if ((frame = parseEndFrame(p, q)) != NULL) {
+			stats->commands++;
+			postEventFromIsr(EVENT_SPI_COMMAND);
+			if (RX_DEBUG) {
+				strcpy(debugBuffer, frame); // command name
 				debugCommandReady = 1;
-				spiRxBufferp = 0;
+				postEventFromIsr(EVENT_DEBUG);
 			}
+		} else {
+			stats->errors++;            // queue full, or command too long
+		}
+	}
 
 	chOld = chNew;
 	chNew = SPDR;
+	ISR_STATS_EXIT(INTERFACE_SPI);
 //	unsigned char ch = SPDR;
 //	sprintf(debugBuffer, "SPI_STC_vect %i, %02x %02x\n", count++, chOld, chNew);
 //	strcpy(debugBuffer, "SPI_SCT_vect\n");
@@ -131,43 +226,12 @@ ISR(SPI_STC_vect) {
 
 
 
-char* processSpiCommand() {
-
-    char* token;						// pointer to current token
-	char* pointer = spiRxBuffer;		// used by strcmp_r
-	static char string[30];				// returned string
-
-	token = strtok_r(spiRxBuffer, " ", &pointer);
-	
-	/* Process "hello: <seq> command. */
-	
-	if (strcmp(token, "hello:") == 0) {
-		
-		strlcpy(string, "ack:", sizeof(string));
-		char* token = strtok_r(NULL, " ", &pointer);    // grab possible <sequence>
-		if (token != NULL) {
-			strlcat(string, " ", sizeof(string));
-			strlcat(string, token, sizeof(string));
-		}
-		strlcat(string, "\n", sizeof(string));
-		return string;
-	}
-
-	/* Process "send: temp" command. */
-
-	if (strcmp(token, "send:") == 0) {
-		token = strtok_r(NULL, " ", &pointer);
-		if ((token != NULL) & (strcmp(token, "temp") == 0)) {
-			return tempString;
-		} else {
-			return "nack:\n";
-		}
-	}
-	
-	if (strcmp(token, "$:") == 0) {
-		return NULL;
-	}
+/* processSpiCommand - process command received over SPI interface.
+ * Commands are shared with the other interfaces (see registerUserCommand()).
+ */
 
-	return "# Command not found\n";
-	
+char* processSpiCommand(char *command, uint8_t length, uint8_t index) {
+	return processUserCommand(command, length, index);
 }
+
+#endif
@@ -5,12 +5,11 @@
 #ifndef TJS_SPI_SLAVE_H
 #define TJS_SPI_SLAVE_H
 
-#include <avr/interrupt.h>
-#include <util/delay.h>
 #include <stdint.h>
 
-#define SPI_RX_BUFFER_LENGTH 50
-#define SPI_TX_BUFFER_LENGTH 50
+#include "tjs_hal.h"
+
+#define SPI_TX_BUFFER_LENGTH 100		// transmit buffer (each of two)
 
 #define SPI_PORT PORTB
 #define SPI_DDR  DDRB
@@ -21,6 +20,10 @@ void tjsSpiSendBytes(void);
 
 void tjsSpiStop(void);
 
+char* processSpiCommand(char *, uint8_t length, uint8_t index);    // process received command, return reply
+char* spiReserve(void);                 // buffer to build next reply in
+void spiSetReply(const char *, uint8_t length, uint8_t binary);    // set reply to next read
+
 void tjsSpiReq();
 
 #endif
@@ -5,7 +5,7 @@
 
 #define F_CPU 16000000ul	// required for _delay_ms()
 
-#include <avr/io.h>
+#include "tjs_hal.h"
 
 
 /* initAdc - initialize ADC.
@@ -0,0 +1,97 @@
+/* tjs_cmdq.c - per-interface queues of received command frames.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "tjs_cmdq.h"
+#include "tjs_hal.h"
+
+cmdQueue cmdQueues[INTERFACES];
+
+
+
+/* cmdqInit - empty a queue and clear its metrics.
+ */
+
+void cmdqInit(cmdQueue *q) {
+
+	unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	q->head = 0;
+	q->tail = 0;
+	q->length = 0;
+	q->wrapEnd = 0;
+	q->frames = 0;
+	q->discarding = 0;
+	q->maxFrames = 0;
+	q->dropped = 0;
+	SREG = sreg;
+}
+
+
+
+/* cmdqResetStats - clear a queue's metrics.
+ */
+
+void cmdqResetStats(cmdQueue *q) {
+
+	unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	q->maxFrames = q->frames;
+	q->dropped = 0;
+	SREG = sreg;
+}
+
+
+
+/* cmdqFront - return the oldest complete frame, or NULL if there is none.
+ * The frame stays in the queue, untouched by the ISR, until cmdqPop().
+ * The caller may modify it in place.
+ */
+
+char* cmdqFront(cmdQueue *q) {
+	if (q->frames == 0) return NULL;
+	return &q->buffer[q->head + 2];
+}
+
+
+
+/* cmdqFrontLength - return the length of the oldest complete frame.
+ */
+
+uint8_t cmdqFrontLength(cmdQueue *q) {
+	return q->buffer[q->head];
+}
+
+
+
+/* cmdqFrontTag - return the tag of the oldest complete frame.
+ */
+
+uint8_t cmdqFrontTag(cmdQueue *q) {
+	return q->buffer[q->head + 1];
+}
+
+
+
+/* cmdqPop - discard the oldest complete frame.
+ */
+
+void cmdqPop(cmdQueue *q) {
+
+	unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	if (q->frames > 0) {
+		q->head += (uint8_t)q->buffer[q->head] + 3;    // length, tag, chars, NUL
+		q->frames--;
+		if (q->wrapEnd && (q->head >= q->wrapEnd)) {
+			q->head = 0;                // skip the unused tail
+			q->wrapEnd = 0;
+		}
+		if (q->frames == 0) q->head = q->tail;    // frame being received, if any
+	}
+	SREG = sreg;
+}
@@ -0,0 +1,156 @@
+/* tjs_cmdq.h - per-interface queues of received command frames.
+ *
+ * Each interface's receive ISR adds characters to the frame being
+ * received, and ends the frame at the command terminator.  Complete
+ * frames wait in the queue, in order, until the main loop has processed
+ * them, so a burst of commands is neither overwritten nor run together.
+ *
+ * Frames are held as NUL-terminated strings, each contiguous and preceded
+ * by its length and a tag byte, in one circular buffer per interface.
+ * (The length lets cmdqPop() find the next frame, although the frame
+ * holds NULs between its tokens; the tag is the command index found by
+ * the tokenizer, see tjs_parse.h.)  A frame that reaches the end of the
+ * buffer while it is being received is moved to the start (if there is
+ * room there), and the consumer skips the unused tail.  If there is no
+ * room, the frame is dropped and counted.
+ *
+ * The ISR side (cmdqPutChar(), cmdqUnputChar(), cmdqEndFrame()) is
+ * inline, and is only called with interrupts disabled.  The main-loop
+ * side is cmdqFront(), cmdqFrontLength(), cmdqFrontTag() and cmdqPop().
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_CMDQ_H
+#define TJS_CMDQ_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "tjs_interfaces.h"
+
+#define CMDQ_BYTES 100                  // frame buffer per interface
+
+typedef struct {
+	char buffer[CMDQ_BYTES];
+	volatile uint8_t head;              // start of oldest complete frame
+	volatile uint8_t tail;              // start of frame being received
+	volatile uint8_t length;            // bytes of frame being received
+	volatile uint8_t wrapEnd;           // frames before head end here (0: not wrapped)
+	volatile uint8_t frames;            // complete frames queued
+	volatile uint8_t discarding;        // frame being received did not fit
+	uint8_t maxFrames;                  // most frames queued at once
+	unsigned int dropped;               // frames dropped (queue full)
+} cmdQueue;
+
+extern cmdQueue cmdQueues[INTERFACES];
+
+void cmdqInit(cmdQueue *);              // empty queue, clear metrics
+char* cmdqFront(cmdQueue *);            // oldest complete frame, or NULL
+uint8_t cmdqFrontLength(cmdQueue *);    // its length (without the final NUL)
+uint8_t cmdqFrontTag(cmdQueue *);       // its tag
+void cmdqPop(cmdQueue *);               // discard oldest complete frame
+void cmdqResetStats(cmdQueue *);        // clear metrics
+
+
+/* cmdqUsed - bytes in use, including the frame being received.
+ */
+
+static inline uint8_t cmdqUsed(cmdQueue *q) {
+	if (q->wrapEnd) return (q->wrapEnd - q->head) + q->tail + q->length + 2;
+	return q->tail + q->length + 2 - q->head;
+}
+
+
+
+/* cmdqMakeRoom - make sure the frame being received has room for need
+ * bytes (counting its length and tag bytes and the chars it already
+ * has).  At the end of the buffer, the frame is moved to the start, if
+ * the frames waiting leave room there.
+ */
+
+static inline uint8_t cmdqMakeRoom(cmdQueue *q, uint8_t need) {
+
+	uint8_t limit = q->wrapEnd ? q->head : CMDQ_BYTES;
+
+	if (q->tail + need <= limit) return 1;
+
+	if (q->frames == 0) {
+		memmove(q->buffer, &q->buffer[q->tail], q->length + 2);
+		q->head = 0;
+		q->tail = 0;
+		q->wrapEnd = 0;
+	} else if (!q->wrapEnd && (need <= q->head)) {
+		memmove(q->buffer, &q->buffer[q->tail], q->length + 2);
+		q->wrapEnd = q->tail;
+		q->tail = 0;
+	}
+	limit = q->wrapEnd ? q->head : CMDQ_BYTES;
+	return q->tail + need <= limit;
+}
+
+
+
+/* cmdqPutChar - add ch to the frame being received.  Returns 0 if it
+ * does not fit (the frame will be dropped when it ends).
+ */
+
+static inline uint8_t cmdqPutChar(cmdQueue *q, char ch) {
+
+	if (q->discarding) return 0;
+	if (!cmdqMakeRoom(q, q->length + 4)) {    // length, tag, ch, and the NUL to come
+		q->discarding = 1;
+		return 0;
+	}
+	q->buffer[q->tail + 2 + q->length++] = ch;
+	return 1;
+}
+
+
+
+/* cmdqUnputChar - remove the last char of the frame being received
+ * (e.g., backspace).
+ */
+
+static inline void cmdqUnputChar(cmdQueue *q) {
+	if (q->length > 0) q->length--;
+}
+
+
+
+/* cmdqDropFrame - discard the frame being received (e.g., bad CRC).
+ */
+
+static inline void cmdqDropFrame(cmdQueue *q) {
+	q->discarding = 0;
+	q->length = 0;
+}
+
+
+
+/* cmdqEndFrame - end the frame being received, and queue it with tag.
+ * Returns the queued frame, or NULL if it was dropped.
+ */
+
+static inline char* cmdqEndFrame(cmdQueue *q, uint8_t tag) {
+
+	char *frame;
+
+	if (q->discarding || !cmdqMakeRoom(q, q->length + 3)) {
+		q->discarding = 0;
+		q->length = 0;
+		q->dropped++;
+		return NULL;
+	}
+	q->buffer[q->tail] = q->length;
+	q->buffer[q->tail + 1] = tag;
+	frame = &q->buffer[q->tail + 2];    // may have moved
+	frame[q->length] = '\0';
+	q->tail += q->length + 3;
+	q->length = 0;
+	q->frames++;
+	if (q->frames > q->maxFrames) q->maxFrames = q->frames;
+	return frame;
+}
+
+#endif
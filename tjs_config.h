@@ -0,0 +1,44 @@
+/* tjs_config.h - build configuration: transports and optional features.
+ *
+ * Each option is 1 (compiled in) or 0 (compiled out), and defaults to 1,
+ * so a plain build has everything.  The Makefile sets them from its
+ * TRANSPORTS, DEBUG and FLOAT variables, e.g.:
+ *
+ *     make TRANSPORTS=i2c DEBUG=0 FLOAT=0
+ *
+ * A transport that is compiled out has no driver code, no ISR and no
+ * reply buffers.  The async USART is also the console, so without
+ * CONFIG_ASYNC only its receive side (the async command interface) goes;
+ * output still goes to the USART.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_CONFIG_H
+#define TJS_CONFIG_H
+
+#ifndef CONFIG_ASYNC
+#define CONFIG_ASYNC 1                  // commands on the async interface
+#endif
+
+#ifndef CONFIG_I2C
+#define CONFIG_I2C 1                    // I2C slave
+#endif
+
+#ifndef CONFIG_SPI
+#define CONFIG_SPI 1                    // SPI slave
+#endif
+
+#ifndef CONFIG_DEBUG
+#define CONFIG_DEBUG 1                  // trace I2C and SPI commands, replies and bytes
+#endif
+
+#ifndef CONFIG_FLOAT
+#define CONFIG_FLOAT 1                  // floating point temperature, printf("%f")
+#endif
+
+#if !CONFIG_ASYNC && !CONFIG_I2C && !CONFIG_SPI
+#error "no command transport configured (CONFIG_ASYNC, CONFIG_I2C, CONFIG_SPI)"
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+/* tjs_crc.h - CRC-16 frame trailers, per interface.
+ *
+ * With "crc: on", every frame (line) on an interface, in both directions,
+ * ends with a trailer: '*' and the CRC of the bytes before it, as 4 hex
+ * digits, ahead of the line end, e.g., "temp: 25.4*5E09\r\n".  Empty lines
+ * have no trailer.  A received frame
+ * whose trailer is missing or wrong is dropped, and counted.
+ *
+ * The CRC is CRC-16/CCITT-FALSE (polynomial 0x1021, initial value
+ * 0xffff, not reflected; "123456789" gives 0x29b1), computed a byte at a
+ * time with a 512-byte table in flash.  It is computed as the bytes pass
+ * through the RX and TX ISRs, so no frame is ever scanned twice.  The
+ * ISR side (crcRx*(), crcTxNext()) is inline, and only called with
+ * interrupts disabled.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_CRC_H
+#define TJS_CRC_H
+
+#include <stdint.h>
+
+#include "tjs_interfaces.h"
+#include "tjs_progmem.h"
+
+#define CRC_INIT 0xffff                 // CRC of no bytes
+
+#define CRC_RX_BODY 0                   // receiving frame body
+#define CRC_RX_DIGITS 1                 // after '*': 1 + hex digits received
+#define CRC_RX_DONE 5                   // '*' and 4 hex digits received
+#define CRC_RX_BAD 6                    // malformed trailer
+
+#define CRC_TX_START 0                  // nothing sent on this line yet
+#define CRC_TX_LINE 1                   // sending line
+#define CRC_TX_DIGITS 2                 // sending trailer: 2 + hex digits sent
+#define CRC_TX_DONE 6                   // trailer sent, line end next
+
+typedef struct {
+	uint8_t enabled;
+	uint8_t state;                      // CRC_RX_*
+	uint16_t crc;                       // CRC of frame body so far
+	uint16_t trailer;                   // CRC received in trailer
+} crcRx;
+
+typedef struct {
+	uint8_t enabled;
+	uint8_t state;                      // CRC_TX_*
+	uint16_t crc;                       // CRC of line sent so far
+} crcTx;
+
+extern const uint16_t crc16Table[256] PROGMEM;
+extern crcRx crcRxState[INTERFACES];
+extern crcTx crcTxState[INTERFACES];
+
+void crcSetEnabled(uint8_t interface, uint8_t enabled);    // turn trailers on or off
+char* processCrcCommand(char *);        // "crc: [<interface>] [on | off]"
+
+
+/* crc16Update - add byte b to crc.
+ */
+
+static inline uint16_t crc16Update(uint16_t crc, uint8_t b) {
+	return (crc << 8) ^ pgm_read_word(&crc16Table[(uint8_t)(crc >> 8) ^ b]);
+}
+
+
+
+/* crcRxTrailer - if ch belongs to the trailer ('*' or after it), check it
+ * and return 1; the receive ISR should then not store it.  Returns 0 for
+ * frame body bytes, and always if CRC is off.
+ */
+
+static inline uint8_t crcRxTrailer(crcRx *r, uint8_t ch) {
+
+	if (!r->enabled) return 0;
+	if (r->state == CRC_RX_BODY) {
+		if (ch != '*') return 0;
+		r->state = CRC_RX_DIGITS;
+		r->trailer = 0;
+		return 1;
+	}
+	if (r->state < CRC_RX_DONE) {
+		uint8_t d;
+		if ((ch >= '0') && (ch <= '9')) d = ch - '0';
+		else if ((ch >= 'A') && (ch <= 'F')) d = ch - 'A' + 10;
+		else if ((ch >= 'a') && (ch <= 'f')) d = ch - 'a' + 10;
+		else {
+			r->state = CRC_RX_BAD;
+			return 1;
+		}
+		r->trailer = (r->trailer << 4) | d;
+		r->state++;
+		return 1;
+	}
+	r->state = CRC_RX_BAD;              // anything after the trailer
+	return 1;
+}
+
+
+
+/* crcRxAdd - add a frame body byte to the CRC.
+ */
+
+static inline void crcRxAdd(crcRx *r, uint8_t ch) {
+	if (r->enabled) r->crc = crc16Update(r->crc, ch);
+}
+
+
+
+/* crcRxEnd - at the end of a frame, return 1 if its trailer is correct
+ * (or CRC is off), 0 if it is not; get ready for the next frame.
+ */
+
+static inline uint8_t crcRxEnd(crcRx *r) {
+
+	uint8_t ok = !r->enabled ||
+	             ((r->state == CRC_RX_DONE) && (r->trailer == r->crc));
+
+	r->state = CRC_RX_BODY;
+	r->crc = CRC_INIT;
+	return ok;
+}
+
+
+
+/* crcTxReset - start a new line (e.g., a new I2C reply).
+ */
+
+static inline void crcTxReset(crcTx *t) {
+	t->state = CRC_TX_START;
+	t->crc = CRC_INIT;
+}
+
+
+
+/* crcTxNext - given ch, the next byte of the line being transmitted,
+ * return the byte to send.  At the end of a line that is not empty ('\r',
+ * '\n', or the NUL after a line with no '\n'), the trailer is sent first: *take is set to 0 while
+ * trailer bytes are returned, and to 1 when ch itself is returned, and
+ * the caller should move on to the next byte.
+ */
+
+static inline uint8_t crcTxNext(crcTx *t, uint8_t ch, uint8_t *take) {
+
+	*take = 1;
+	if (!t->enabled) return ch;
+
+	if ((t->state >= CRC_TX_DIGITS) && (t->state < CRC_TX_DONE)) {
+		uint8_t d = (t->crc >> ((CRC_TX_DONE - 1 - t->state) * 4)) & 0xf;
+		t->state++;
+		*take = 0;
+		return (d < 10) ? '0' + d : 'A' - 10 + d;
+	}
+	if ((t->state == CRC_TX_LINE) && ((ch == '\r') || (ch == '\n') || (ch == 0))) {
+		t->state = CRC_TX_DIGITS;
+		*take = 0;
+		return '*';
+	}
+	if ((ch == '\n') || (ch == 0)) {
+		t->state = CRC_TX_START;
+		t->crc = CRC_INIT;
+	} else if (ch != '\r') {
+		t->crc = crc16Update(t->crc, ch);
+		t->state = CRC_TX_LINE;
+	}
+	return ch;
+}
+
+#endif
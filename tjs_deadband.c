@@ -0,0 +1,92 @@
+/* tjs_deadband.c - report-by-exception (deadband / heartbeat) filter.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tjs_deadband.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+#include "tjs_reply.h"
+
+
+int deadbandEnabled = 0;                // off: report every sample, as before
+int16_t deadbandDelta = 2;              // 0.2 degrees C
+unsigned long deadbandHeartbeat = 10000; // 10 seconds
+
+
+/* deadbandReset - forget the last report, so the next sample is reported.
+ */
+
+void deadbandReset(deadbandState *state) {
+	state->valid = 0;
+}
+
+
+
+/* deadbandCheck - decide whether to report value.
+ *
+ * Returns true (and records value as the last report) if deadband mode is
+ * off, nothing has been reported yet, the value has moved by more than
+ * deadbandDelta, or deadbandHeartbeat msec have passed since the last
+ * report.
+ */
+
+int deadbandCheck(deadbandState *state, int16_t value, unsigned long now) {
+
+	if (deadbandEnabled && state->valid) {
+		int16_t delta = value - state->lastValue;
+		if (delta < 0) delta = -delta;
+		if ((delta <= deadbandDelta) && (now - state->lastTime < deadbandHeartbeat)) {
+			return 0;                   // inside deadband, heartbeat not due
+		}
+	}
+
+	state->lastValue = value;
+	state->lastTime = now;
+	state->valid = 1;
+	return 1;
+}
+
+
+
+/* processDeadbandCommand - process "deadband: [on | off | <delta> [<heartbeat>]]"
+ * command.  <delta> is in 0.1 degrees C, <heartbeat> in msec.  A
+ * "deadband:" command with no parameter toggles deadband mode.
+ * Note: this code is not reentrant.
+ */
+
+char* processDeadbandCommand(char *command) {
+
+	const uint8_t size = 50;
+	char *string = replySlot(size);
+
+	char* token = nextArg();             // grab possible parameter
+
+	if (token == NULL) {
+		deadbandEnabled = !deadbandEnabled;    // toggle
+	} else if (strcmp_P(token, PSTR("on")) == 0) {
+		deadbandEnabled = 1;
+	} else if (strcmp_P(token, PSTR("off")) == 0) {
+		deadbandEnabled = 0;
+	} else if ((*token >= '0') && (*token <= '9')) {
+		int16_t delta = atoi(token);
+		token = nextArg();               // grab possible <heartbeat>
+		if (token != NULL) {
+			if ((*token < '0') || (*token > '9')) return progmemReply(PSTR("nack:\n"));
+			deadbandHeartbeat = atol(token);
+		}
+		deadbandDelta = delta;
+		deadbandEnabled = 1;
+	} else {
+		return progmemReply(PSTR("nack:\n"));
+	}
+
+	snprintf_P(string, size, PSTR("deadband: " PGM_S " %d %lu\n"),
+	         deadbandEnabled ? PSTR("on") : PSTR("off"), deadbandDelta, deadbandHeartbeat);
+	return string;
+}
@@ -0,0 +1,31 @@
+/* tjs_deadband.h - report-by-exception (deadband / heartbeat) filter.
+ *
+ * A sample is reported only if it differs from the last reported sample
+ * by more than the deadband, or if the heartbeat interval has passed
+ * since the last report.  Each interface keeps its own deadbandState, so
+ * that each one reports changes independently.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_DEADBAND_H
+#define TJS_DEADBAND_H
+
+#include <stdint.h>
+
+typedef struct {
+	int16_t lastValue;                  // last reported value
+	unsigned long lastTime;             // msec clock of last report
+	uint8_t valid;                      // set once something has been reported
+} deadbandState;
+
+extern int deadbandEnabled;             // report by exception, rather than always
+extern int16_t deadbandDelta;           // report if value moves by more than this
+extern unsigned long deadbandHeartbeat; // report at least this often (msec)
+
+void deadbandReset(deadbandState *);    // force next sample to be reported
+int deadbandCheck(deadbandState *, int16_t value, unsigned long now);    // true if sample should be reported
+
+char* processDeadbandCommand(char *);   // "deadband: [on | off | <delta> [<heartbeat>]]"
+
+#endif
@@ -0,0 +1,113 @@
+/* tjs_delta.c - delta / varint compression of sample values.
+ *
+ * Encoding of one sample:
+ *
+ *   delta  = value - prev              (16-bit, wraps)
+ *   zigzag = (delta << 1) ^ (delta >> 15)
+ *   varint = 7 bits per byte, low bits first, high bit set if more follow
+ *
+ * A delta of -64..63 takes one byte, -8192..8191 takes two bytes, and
+ * anything else takes three bytes.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdint.h>
+
+#include "tjs_delta.h"
+
+
+/* deltaEncode - encode value as a delta from prev.
+ * out must have room for DELTA_MAX_BYTES bytes.  Returns number of bytes
+ * written.
+ */
+
+uint8_t deltaEncode(int16_t prev, int16_t value, uint8_t *out) {
+
+	int16_t delta = (int16_t)((uint16_t)value - (uint16_t)prev);
+	uint16_t zigzag = ((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15);
+	uint8_t n = 0;
+
+	while (zigzag >= 0x80) {
+		out[n++] = (zigzag & 0x7f) | 0x80;    // more bytes follow
+		zigzag >>= 7;
+	}
+	out[n++] = zigzag;
+	return n;
+}
+
+
+
+/* deltaDecode - decode one delta from in[0..len-1], relative to prev.
+ * Returns the number of bytes consumed, or 0 if the encoding is truncated
+ * or malformed.
+ */
+
+uint8_t deltaDecode(int16_t prev, const uint8_t *in, uint8_t len, int16_t *value) {
+
+	uint16_t zigzag = 0;
+	uint8_t n = 0;
+	uint8_t shift = 0;
+
+	while (n < len && n < DELTA_MAX_BYTES) {
+		uint8_t b = in[n++];
+		zigzag |= (uint16_t)(b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			int16_t delta = (int16_t)((zigzag >> 1) ^ -(zigzag & 1));
+			*value = (int16_t)((uint16_t)prev + (uint16_t)delta);
+			return n;
+		}
+		shift += 7;
+	}
+	return 0;                           // truncated or too long
+}
+
+
+
+/* hexEncode - convert len bytes to a null-terminated hex string.
+ * Returns number of chars written (not counting the null), which is less
+ * than 2 * len if out is too short.
+ */
+
+uint8_t hexEncode(const uint8_t *in, uint8_t len, char *out, uint8_t outLen) {
+
+	uint8_t n = 0;
+
+	if (outLen == 0) return 0;
+	while (len-- && (n + 2 < outLen)) {
+		uint8_t hi = *in >> 4;
+		uint8_t lo = *in++ & 0xf;
+		out[n++] = hi < 10 ? '0' + hi : 'a' + hi - 10;
+		out[n++] = lo < 10 ? '0' + lo : 'a' + lo - 10;
+	}
+	out[n] = '\0';
+	return n;
+}
+
+
+
+/* hexDecode - convert a hex string to bytes.
+ * Stops at the first non-hex char.  Returns number of bytes written.
+ */
+
+static int8_t hexValue(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+uint8_t hexDecode(const char *in, uint8_t *out, uint8_t outLen) {
+
+	uint8_t n = 0;
+
+	while (n < outLen) {
+		int8_t hi = hexValue(in[0]);
+		if (hi < 0) break;
+		int8_t lo = hexValue(in[1]);
+		if (lo < 0) break;
+		out[n++] = (hi << 4) | lo;
+		in += 2;
+	}
+	return n;
+}
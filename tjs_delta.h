@@ -0,0 +1,26 @@
+/* tjs_delta.h - delta / varint compression of sample values.
+ *
+ * A sample is encoded as the difference from the previous sample.  The
+ * difference is zig-zag encoded (so that small negative differences are
+ * small positive numbers) and packed as a little-endian base-128 varint.
+ * Slowly changing signals, such as the on-chip temperature, compress to
+ * one byte per sample.
+ *
+ * This code has no AVR dependencies, so it can also be built on the host.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_DELTA_H
+#define TJS_DELTA_H
+
+#include <stdint.h>
+
+#define DELTA_MAX_BYTES 3               // max bytes in one encoded 16-bit delta
+
+uint8_t deltaEncode(int16_t prev, int16_t value, uint8_t *out);    // encode value, return length
+uint8_t deltaDecode(int16_t prev, const uint8_t *in, uint8_t len, int16_t *value);    // decode, return length used
+uint8_t hexEncode(const uint8_t *in, uint8_t len, char *out, uint8_t outLen);    // bytes to hex string
+uint8_t hexDecode(const char *in, uint8_t *out, uint8_t outLen);  // hex string to bytes
+
+#endif
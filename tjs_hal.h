@@ -0,0 +1,45 @@
+/* tjs_hal.h - hardware abstraction layer.
+ *
+ * The drivers (simpleSerial.c, tjsI2cSlave.c, tjsSpiSlave.c, tjs_adc.c,
+ * tjs_msec_clock.c, ...) include this header instead of the avr-libc
+ * hardware headers.  On the AVR it simply pulls in those headers, so the
+ * drivers keep using the registers directly and the generated code is
+ * unchanged.
+ *
+ * Elsewhere (the "make host" build) it pulls in host/tjs_hal_host.h,
+ * which provides the same registers, ISR() and interrupt, sleep and
+ * delay primitives on top of a simulation of the peripherals, so the
+ * firmware runs as a native Linux process.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_HAL_H
+#define TJS_HAL_H
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#ifdef __AVR__
+
+#include <stdio.h>
+#include <avr/boot.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/delay.h>
+#include <util/twi.h>
+
+/* HAL_STDIO_INIT - direct stdout and stdin to the USART streams. */
+
+#define HAL_STDIO_INIT(out, in) do { stdout = &(out); stdin = &(in); } while (0)
+
+#else
+
+#include "host/tjs_hal_host.h"
+
+#endif
+
+#endif
@@ -0,0 +1,179 @@
+/* tjs_history.c - SRAM history of sensor samples.
+ *
+ * Each block holds a key-frame plus up to HISTORY_BLOCK_BYTES bytes of
+ * delta-encoded samples.  A block can be decoded on its own, so a host
+ * can fetch the history one block at a time, and the oldest block can be
+ * dropped without touching the others.
+ *
+ * Sample timestamps are not stored individually.  The samples in a block
+ * are taken every "period" msec, starting at the block's key-frame time;
+ * a sample off that schedule starts a new block.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tjs_delta.h"
+#include "tjs_history.h"
+
+
+static historyBlock blocks[HISTORY_BLOCKS];    // history ring
+static uint8_t head = 0;                // newest block
+static uint8_t used = 0;                // blocks in use
+static uint16_t nextSeq = 0;            // sequence number of next sample
+static unsigned int samplePeriod = 100; // msec between samples
+
+
+/* historyInit - clear history and set the sample period.
+ */
+
+void historyInit(unsigned int period) {
+	head = 0;
+	used = 0;
+	nextSeq = 0;
+	samplePeriod = period;
+}
+
+
+
+/* historyDue - time the next sample added to block should be taken.
+ */
+
+static inline unsigned long historyDue(const historyBlock *block) {
+	return block->time + (unsigned long)block->count * samplePeriod;
+}
+
+
+
+/* historyAdd - add a sample to the history.
+ * Starts a new block (discarding the oldest, if necessary) if the sample
+ * does not fit in the current block, or was not taken one period after
+ * the last (sampling paused, or periods skipped), since sample times are
+ * not stored.  Being up to half a period off (the timer callbacks run
+ * from the main loop) counts as on time.  Returns the sample's
+ * sequence number.
+ */
+
+uint16_t historyAdd(int16_t value, unsigned long time) {
+
+	uint8_t encoded[DELTA_MAX_BYTES];
+	uint8_t n = 0;
+	historyBlock *block = &blocks[head];
+
+	if (used != 0) {
+		n = deltaEncode(block->last, value, encoded);
+	}
+
+	if ((used == 0) || (block->count == 255) ||
+	    (block->length + n > HISTORY_BLOCK_BYTES) ||
+	    (time - historyDue(block) + samplePeriod / 2 >= samplePeriod)) {
+
+		/* Start a new block with a key-frame. */
+
+		head = (head + 1) % HISTORY_BLOCKS;
+		if (used < HISTORY_BLOCKS) used++;
+		block = &blocks[head];
+		block->seq = nextSeq;
+		block->time = time;
+		block->key = value;
+		block->count = 0;
+		block->length = 0;
+	} else {
+		memcpy(&block->data[block->length], encoded, n);
+		block->length += n;
+	}
+
+	block->last = value;
+	block->count++;
+	return nextSeq++;
+}
+
+
+
+/* historyBlockAt - return block n, where block 0 is the oldest.
+ */
+
+const historyBlock* historyBlockAt(uint8_t n) {
+	if (n >= used) return NULL;
+	return &blocks[(head + HISTORY_BLOCKS - used + 1 + n) % HISTORY_BLOCKS];
+}
+
+
+
+/* historyGet - look up sample seq.  Returns 1 if found, 0 if the sample
+ * is no longer (or not yet) held.
+ */
+
+int historyGet(uint16_t seq, int16_t *value, unsigned long *time) {
+
+	uint8_t i;
+
+	for (i = 0; i < used; i++) {
+		const historyBlock *block = historyBlockAt(i);
+		uint16_t offset = seq - block->seq;    // wraps
+		if (offset >= block->count) continue;
+
+		int16_t v = block->key;
+		uint8_t p = 0;
+		uint16_t k;
+		for (k = 0; k < offset; k++) {
+			uint8_t n = deltaDecode(v, &block->data[p], block->length - p, &v);
+			if (n == 0) return 0;       // should never happen
+			p += n;
+		}
+		*value = v;
+		*time = block->time + (unsigned long)offset * samplePeriod;
+		return 1;
+	}
+	return 0;
+}
+
+
+
+uint16_t historyNextSeq(void) {
+	return nextSeq;
+}
+
+
+unsigned int historyPeriod(void) {
+	return samplePeriod;
+}
+
+
+/* historyOldestSeq - sequence number of the oldest sample held (the next
+ * sample's, if none are held).
+ */
+
+uint16_t historyOldestSeq(void) {
+	if (used == 0) return nextSeq;
+	return historyBlockAt(0)->seq;
+}
+
+
+uint8_t historyBlockCount(void) {
+	return used;
+}
+
+
+/* historySamples / historyBytes - samples held, and the bytes used to
+ * hold them (key-frame plus encoded deltas).
+ */
+
+unsigned int historySamples(void) {
+	unsigned int n = 0;
+	uint8_t i;
+	for (i = 0; i < used; i++) n += historyBlockAt(i)->count;
+	return n;
+}
+
+
+unsigned int historyBytes(void) {
+	unsigned int n = 0;
+	uint8_t i;
+	for (i = 0; i < used; i++) n += sizeof(int16_t) + historyBlockAt(i)->length;
+	return n;
+}
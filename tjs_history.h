@@ -0,0 +1,40 @@
+/* tjs_history.h - SRAM history of sensor samples.
+ *
+ * Samples are held in a ring of small blocks.  Each block starts with a
+ * key-frame value and holds the following samples as delta/varint
+ * encoded differences (see tjs_delta.h).  When the ring is full, the
+ * oldest block is discarded.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_HISTORY_H
+#define TJS_HISTORY_H
+
+#include <stdint.h>
+
+#define HISTORY_BLOCKS 6                // blocks in history ring
+#define HISTORY_BLOCK_BYTES 24          // encoded delta bytes per block
+
+typedef struct {
+	uint16_t seq;                       // sequence number of key-frame sample
+	unsigned long time;                 // msec clock of key-frame sample
+	int16_t key;                        // key-frame value
+	int16_t last;                       // last value added to block
+	uint8_t count;                      // samples in block, including key-frame
+	uint8_t length;                     // bytes used in data[]
+	uint8_t data[HISTORY_BLOCK_BYTES];  // encoded deltas
+} historyBlock;
+
+void historyInit(unsigned int period);    // clear history, set sample period (msec)
+uint16_t historyAdd(int16_t value, unsigned long time);    // add sample, return its sequence
+int historyGet(uint16_t seq, int16_t *value, unsigned long *time);    // look up sample by sequence
+uint16_t historyNextSeq(void);          // sequence number of next sample
+unsigned int historyPeriod(void);       // msec between samples
+uint16_t historyOldestSeq(void);        // sequence number of oldest sample held
+uint8_t historyBlockCount(void);        // number of blocks in use
+const historyBlock* historyBlockAt(uint8_t n);    // block n (0 = oldest)
+unsigned int historySamples(void);      // samples currently held
+unsigned int historyBytes(void);        // bytes used to hold them
+
+#endif
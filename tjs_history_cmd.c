@@ -0,0 +1,145 @@
+/* tjs_history_cmd.c - commands that return samples from the history.
+ *
+ * Kept apart from tjs_history.c, so the history itself links on its own
+ * (e.g., into tools/deltaBench) without the command and reply code.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tjs_delta.h"
+#include "tjs_history.h"
+#include "tjs_history_cmd.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+#include "tjs_reply.h"
+
+
+
+/* historyBatch - format samples first, first+1, ... (at most count of
+ * them, and only those still held) as one reply, so a host can fetch many
+ * samples in one bus transaction.  Samples are added until the reply
+ * buffer is full; the host asks again for the rest.
+ *
+ * Text (binary = 0):
+ *     "temps: <n> <seq>,<time>,<value> ..."
+ * with <value> in degrees C, as in "temp:".
+ *
+ * Binary (binary = 1), hex encoded as for "hist:":
+ *     "tempb: <hex>"
+ * The bytes are <n> (1), <seq> (2), <time> (4), then for each sample
+ * <value> (2, 0.1 degrees C) and <msec since previous sample> (2).  All
+ * multi-byte fields are little-endian; sequence numbers are consecutive.
+ *
+ * Note: this code is not reentrant.
+ */
+
+char* historyBatch(uint16_t first, uint16_t count, uint8_t binary) {
+
+	char *string = replySlot(REPLY_MAX);
+	char body[REPLY_MAX - 12];          // room for "temps: <n>" and "\n"
+	uint8_t bytes[(REPLY_MAX - 9) / 2];         // room for "tempb: " and "\n"
+	uint16_t oldest = historyOldestSeq();
+	uint16_t nextSeq = historyNextSeq();
+	uint8_t length = 7;                 // binary header
+	uint8_t bodyLength = 0;
+	uint8_t n;
+	int16_t value;
+	unsigned long time;
+	unsigned long lastTime = 0;
+
+	/* Skip samples already discarded; stop at the newest. */
+
+	if ((int16_t)(first - oldest) < 0) first = oldest;
+	if ((int16_t)(nextSeq - first) <= 0) count = 0;
+	else if (count > (uint16_t)(nextSeq - first)) count = nextSeq - first;
+	if (count > 255) count = 255;
+
+	memset(bytes, 0, 7);
+	body[0] = '\0';
+
+	for (n = 0; n < count; n++) {
+		uint16_t seq = first + n;
+		if (!historyGet(seq, &value, &time)) break;
+		if (binary) {
+			if (length + 4 > sizeof(bytes)) break;
+			if (n == 0) {
+				bytes[1] = seq;
+				bytes[2] = seq >> 8;
+				bytes[3] = time;
+				bytes[4] = time >> 8;
+				bytes[5] = time >> 16;
+				bytes[6] = time >> 24;
+				lastTime = time;
+			}
+			bytes[length++] = value;
+			bytes[length++] = value >> 8;
+			bytes[length++] = time - lastTime;
+			bytes[length++] = (time - lastTime) >> 8;
+			lastTime = time;
+		} else {
+			unsigned int v = (value < 0) ? -value : value;
+			int m = snprintf_P(&body[bodyLength], sizeof(body) - bodyLength,
+			                   PSTR(" %u,%lu," PGM_S "%u.%u"), seq, time,
+			                   (value < 0) ? PSTR("-") : PSTR(""), v / 10, v % 10);
+			if (bodyLength + m >= sizeof(body)) {
+				body[bodyLength] = '\0';    // did not fit
+				break;
+			}
+			bodyLength += m;
+		}
+	}
+
+	if (binary) {
+		bytes[0] = n;
+		int m = snprintf_P(string, REPLY_MAX, PSTR("tempb: "));
+		m += hexEncode(bytes, length, &string[m], REPLY_MAX - m - 1);
+		string[m++] = '\n';
+		string[m] = '\0';
+	} else {
+		snprintf_P(string, REPLY_MAX, PSTR("temps: %u%s\n"), n, body);
+	}
+	return string;
+}
+
+
+
+/* processHistoryCommand - process "history: [<block>]" command.
+ *
+ * With no parameter, returns a summary:
+ *     "history: <blocks> <samples> <bytes> <raw>"
+ * where <raw> is the number of bytes the same samples would take as
+ * "temp: nn.n\r\n" lines.
+ *
+ * With a block number (0 = oldest), returns that block:
+ *     "hist: <seq> <time> <period> <key> <count> <hex deltas>"
+ *
+ * Note: this code is not reentrant.
+ */
+
+char* processHistoryCommand(char *command) {
+
+	char *string = replySlot(REPLY_MAX);
+	char* token = nextArg();             // grab possible <block>
+
+	if (token == NULL) {
+		unsigned int samples = historySamples();
+		snprintf_P(string, REPLY_MAX, PSTR("history: %u %u %u %u\n"),
+		         (unsigned int)historyBlockCount(), samples, historyBytes(), samples * 12);
+		return string;
+	}
+
+	const historyBlock *block = historyBlockAt(atoi(token));
+	if (block == NULL) return progmemReply(PSTR("nack:\n"));
+
+	int n = snprintf_P(string, REPLY_MAX, PSTR("hist: %u %lu %u %d %u "),
+	                 block->seq, block->time, historyPeriod(), block->key, block->count);
+	n += hexEncode(block->data, block->length, &string[n], REPLY_MAX - n - 1);
+	string[n++] = '\n';
+	string[n] = '\0';
+	return string;
+}
@@ -0,0 +1,14 @@
+/* tjs_history_cmd.h - commands that return samples from the history.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_HISTORY_CMD_H
+#define TJS_HISTORY_CMD_H
+
+#include <stdint.h>
+
+char* historyBatch(uint16_t first, uint16_t count, uint8_t binary);    // "temps:"/"tempb:" reply
+char* processHistoryCommand(char *);    // "history: [<block>]" command
+
+#endif
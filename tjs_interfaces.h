@@ -0,0 +1,21 @@
+/* tjs_interfaces.h - interfaces (transports) to the host.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_INTERFACES_H
+#define TJS_INTERFACES_H
+
+#define INTERFACE_ASYNC 0
+#define INTERFACE_I2C 1
+#define INTERFACE_SPI 2
+#define INTERFACES 3
+
+#include "tjs_progmem.h"
+
+#define INTERFACE_NAME_LENGTH 6         // longest name ("async"), and NUL
+
+extern const char interfaceNames[INTERFACES][INTERFACE_NAME_LENGTH] PROGMEM;    // in flash (tjs_linkstats.c)
+extern int commandInterface;            // interface of command being processed (main.c)
+
+#endif
@@ -1,9 +1,27 @@
-/* tjs_leds.c - miscellaneous LED functions.
+/* tjs_leds.c - miscellaneous LED functions, and the LED status engine.
  *
  * Copyright (C) Timothy J. Salo, 2018.
  */
 
-#include <avr/io.h>
+#include <stdint.h>
+
+#include "tjs_hal.h"
+#include "tjs_leds.h"
+#include "tjs_progmem.h"
+
+/* Patterns of each status, for red, yellow and green: bit n is frame n
+ * (1 = on). */
+
+static const uint8_t ledPatterns[LED_STATUSES][LEDS] PROGMEM = {
+	{0x00, 0x00, 0x00},                 // LED_STATUS_OFF
+	{0x0f, 0x00, 0x00},                 // LED_STATUS_BOOT
+	{0x00, 0x00, 0x05},                 // LED_STATUS_RUN: two short beats
+};
+
+volatile uint8_t ledStatus = LED_STATUS_OFF;
+volatile uint8_t ledFlashes[LEDS];
+uint8_t ledCountdown = LED_FRAME_MSEC;
+static uint8_t ledFrame;                // next frame to show
 
 
 void enableYellowLED() {                // 
@@ -151,4 +169,55 @@ void displayOctalDigit(int n) {
 		onRedLED();
 	else
 		offRedLED();
-}
\ No newline at end of file
+}
+
+
+
+/* ledsInit - enable the on-board LEDs, all off, and show LED_STATUS_BOOT.
+ * Call after tjsSpiInit(), which sets all of DDRB.
+ */
+
+void ledsInit(void) {
+
+	unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	enableRedLED();
+	enableYellowLED();
+	enableGreenLED();
+	offRedLED();
+	offYellowLED();
+	offGreenLED();
+	ledFrame = 0;
+	ledCountdown = 1;                   // first frame at the next msec
+	ledStatus = LED_STATUS_BOOT;
+	SREG = sreg;
+}
+
+
+
+/* ledsRender - show the next frame of the current status's patterns, with
+ * any flashes, and clear the flashes.  Called from the timer 4 ISR, every
+ * LED_FRAME_MSEC.
+ */
+
+void ledsRender(void) {
+
+	uint8_t status = ledStatus;
+	uint8_t bit = 1 << ledFrame;
+	uint8_t on[LEDS];
+	uint8_t i;
+
+	if (status >= LED_STATUSES) status = LED_STATUS_OFF;
+	for (i = 0; i < LEDS; i++) {
+		on[i] = (pgm_read_byte(&ledPatterns[status][i]) & bit) || ledFlashes[i];
+		ledFlashes[i] = 0;
+	}
+	ledFrame = (ledFrame + 1) & (LED_FRAMES - 1);
+
+	if (on[LED_RED]) PORTB &= ~(1 << PORTB0);    // red and green are active low
+	else PORTB |= (1 << PORTB0);
+	if (on[LED_YELLOW]) PORTC |= (1 << PORTC7);
+	else PORTC &= ~(1 << PORTC7);
+	if (on[LED_GREEN]) PORTD &= ~(1 << PORTD5);
+	else PORTD |= (1 << PORTD5);
+}
@@ -1,8 +1,77 @@
-/* tjs_leds.h - miscellaneous LED functions.
+/* tjs_leds.h - miscellaneous LED functions, and the LED status engine.
+ *
+ * The status engine drives the three on-board LEDs from the timer 4 ISR,
+ * so nothing else touches the LED ports.  Code reports what it wants
+ * shown with one store:
+ *
+ *   - ledsPost(status) selects the board status (LED_STATUS_*), a set of
+ *     blink and heartbeat patterns, one per LED;
+ *   - ledsFlash(led) lights led for the next frame, over its pattern
+ *     (activity: I2C and SPI traffic on yellow, async output waiting
+ *     for room on red).
+ *
+ * Every LED_FRAME_MSEC, ledsTick() renders the next of the LED_FRAMES
+ * frames of the patterns (one bit each) to the ports.
  *
  * Copyright (C) Timothy J. Salo, 2018.
  */
- 
+
+#ifndef TJS_LEDS_H
+#define TJS_LEDS_H
+
+#include <stdint.h>
+
+#define LED_RED 0
+#define LED_YELLOW 1
+#define LED_GREEN 2
+#define LEDS 3
+
+#define LED_STATUS_OFF 0                // all off
+#define LED_STATUS_BOOT 1               // red blinking, 500 msec on, 500 off
+#define LED_STATUS_RUN 2                // green heartbeat
+#define LED_STATUSES 3
+
+#define LED_FRAMES 8                    // frames per pattern (bits)
+#define LED_FRAME_MSEC 125              // so a pattern lasts a second
+
+extern volatile uint8_t ledStatus;      // LED_STATUS_*
+extern volatile uint8_t ledFlashes[LEDS];    // light for the next frame
+extern uint8_t ledCountdown;            // msec to the next frame (timer 4 ISR)
+
+void ledsInit(void);                    // enable the LEDs, status LED_STATUS_BOOT
+void ledsRender(void);                  // show the next frame (timer 4 ISR)
+
+
+/* ledsPost - show status (LED_STATUS_*) from the next frame on.
+ */
+
+static inline void ledsPost(uint8_t status) {
+	ledStatus = status;
+}
+
+
+
+/* ledsFlash - light led (LED_*) for the next frame.
+ */
+
+static inline void ledsFlash(uint8_t led) {
+	ledFlashes[led] = 1;
+}
+
+
+
+/* ledsTick - count down to the next frame.  Called every msec by the
+ * timer 4 ISR.
+ */
+
+static inline void ledsTick(void) {
+	if (--ledCountdown == 0) {
+		ledCountdown = LED_FRAME_MSEC;
+		ledsRender();
+	}
+}
+
+
 void enableYellowLED();
 void enableGreenLED();
 void enableRedLED();
@@ -31,4 +100,6 @@ void toggleExternalYellowLED();
 void toggleExternalGreenLED();
 void toggleExternalRedLED();
 
-void displayOctalDigit(int);
\ No newline at end of file
+void displayOctalDigit(int);
+
+#endif
@@ -0,0 +1,145 @@
+/* tjs_linkstats.c - per-interface traffic and latency counters.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tjs_cmdq.h"
+#include "tjs_hal.h"
+#include "tjs_linkstats.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+#include "tjs_reply.h"
+
+linkStats linkStatistics[INTERFACES];
+
+const char interfaceNames[INTERFACES][INTERFACE_NAME_LENGTH] PROGMEM = {"async", "i2c", "spi"};
+
+
+/* linkStatsInit - start timer 1 as a free-running cycle counter (no
+ * prescaler, normal mode, no interrupts), and clear the counters.
+ */
+
+void linkStatsInit(void) {
+
+    unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10);               // clk/1
+	TCCR1C = 0;
+	TIMSK1 = 0;
+	SREG = sreg;
+
+	linkStatsReset();
+}
+
+
+
+/* linkStatsReset - clear all counters.
+ */
+
+void linkStatsReset(void) {
+    unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	memset(linkStatistics, 0, sizeof(linkStatistics));
+	SREG = sreg;
+}
+
+
+
+/* linkStatsLatency - record the time from a command being received to
+ * its reply being ready, in 4 usec ticks.  Bucket n counts latencies of
+ * 2^(n-1) to 2^n - 1 ticks (bucket 0 is 0 ticks); the last bucket also
+ * counts everything longer.
+ */
+
+void linkStatsLatency(uint8_t interface, unsigned int ticks) {
+
+	uint8_t bucket = 0;
+
+	while ((ticks != 0) && (bucket < LATENCY_BUCKETS - 1)) {
+		ticks >>= 1;
+		bucket++;
+	}
+	linkStatistics[interface].latency[bucket]++;
+}
+
+
+
+/* processStatsCommand - process "stats: [<interface> [lat|queue] | reset]".
+ *
+ * "stats: <interface>" (async, i2c, or spi; default async) returns:
+ *     "stats: <if> <in> <out> <cmds> <errs> <isrs> <isr mean> <isr max> <rx hw> <tx hw> <dropped> <crc>"
+ * with ISR times in CPU cycles.  <dropped> counts telemetry and debug lines
+ * dropped from the async transmit queues, <crc> received frames dropped
+ * for a bad CRC trailer.
+ * "stats: <interface> lat" returns the latency histogram:
+ *     "lat: <if> <bucket 0> ... <bucket 11>"
+ * "stats: <interface> queue" returns the command queue depth:
+ *     "queue: <if> <queued> <max queued> <dropped>"
+ * "stats: reset" clears all counters.
+ *
+ * Note: this code is not reentrant.
+ */
+
+char* processStatsCommand(char *command) {
+
+	char *string = replySlot(REPLY_MAX);
+	char name[INTERFACE_NAME_LENGTH];
+	uint8_t i = INTERFACE_ASYNC;
+	char* token = nextArg();
+
+	if (token != NULL) {
+		if (strcmp_P(token, PSTR("reset")) == 0) {
+			linkStatsReset();
+			for (i = 0; i < INTERFACES; i++) cmdqResetStats(&cmdQueues[i]);
+			return progmemReply(PSTR("stats: reset\n"));
+		}
+		for (i = 0; i < INTERFACES; i++) {
+			if (strcmp_P(token, interfaceNames[i]) == 0) break;
+		}
+		if (i == INTERFACES) return progmemReply(PSTR("nack:\n"));
+		token = nextArg();
+	}
+
+	/* Take a consistent copy; the ISRs update these. */
+
+	linkStats s;
+    unsigned char sreg = SREG;
+	cli();
+	s = linkStatistics[i];
+	SREG = sreg;
+	strcpy_P(name, interfaceNames[i]);
+
+	if ((token != NULL) && (strcmp_P(token, PSTR("lat")) == 0)) {
+		int n = snprintf_P(string, REPLY_MAX, PSTR("lat: %s"), name);
+		uint8_t b;
+		for (b = 0; b < LATENCY_BUCKETS; b++) {
+			n += snprintf_P(&string[n], REPLY_MAX - n, PSTR(" %u"), s.latency[b]);
+		}
+		snprintf_P(&string[n], REPLY_MAX - n, PSTR("\n"));
+		return string;
+	}
+
+	if ((token != NULL) && (strcmp_P(token, PSTR("queue")) == 0)) {
+		cmdQueue *q = &cmdQueues[i];
+		sreg = SREG;
+		cli();
+		uint8_t frames = q->frames;
+		uint8_t maxFrames = q->maxFrames;
+		unsigned int dropped = q->dropped;
+		SREG = sreg;
+		snprintf_P(string, REPLY_MAX, PSTR("queue: %s %u %u %u\n"),
+		         name, frames, maxFrames, dropped);
+		return string;
+	}
+
+	snprintf_P(string, REPLY_MAX, PSTR("stats: %s %lu %lu %u %u %u %lu %u %u %u %u %u\n"),
+	         name, s.bytesIn, s.bytesOut, s.commands, s.errors,
+	         s.isrCount, s.isrCount ? s.isrCycles / s.isrCount : 0,
+	         s.isrMaxCycles, s.rxHighWater, s.txHighWater, s.txDropped, s.crcErrors);
+	return string;
+}
@@ -0,0 +1,66 @@
+/* tjs_linkstats.h - per-interface traffic and latency counters.
+ *
+ * The counters are updated by the interface ISRs and the main-loop
+ * command handlers.  Updates are only increments and compares; all
+ * formatting is done by the "stats:" command, in the main loop.
+ *
+ * ISR durations are measured in CPU cycles with timer 1, which
+ * linkStatsInit() sets up as a free-running counter at the CPU clock.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_LINKSTATS_H
+#define TJS_LINKSTATS_H
+
+#include <stdint.h>
+
+#include "tjs_hal.h"
+#include "tjs_interfaces.h"
+
+#define LATENCY_BUCKETS 12              // log2 buckets of 4 usec ticks
+
+typedef struct {
+	unsigned long bytesIn;              // bytes received
+	unsigned long bytesOut;             // bytes transmitted
+	unsigned int commands;              // commands received
+	unsigned int errors;                // overruns, framing and bus errors
+	unsigned int isrCount;              // ISR invocations
+	unsigned long isrCycles;            // total ISR cycles
+	unsigned int isrMaxCycles;          // longest ISR
+	uint8_t rxHighWater;                // most bytes in receive buffer
+	uint8_t txHighWater;                // most bytes in transmit buffer
+	unsigned int txDropped;             // low-priority lines dropped (async)
+	unsigned int crcErrors;             // frames dropped, bad CRC trailer
+	unsigned int latency[LATENCY_BUCKETS];    // command-ready to reply-ready
+} linkStats;
+
+extern linkStats linkStatistics[INTERFACES];
+
+void linkStatsInit(void);               // start cycle counter, clear counters
+void linkStatsReset(void);              // clear counters
+void linkStatsLatency(uint8_t interface, unsigned int ticks);    // record a command latency
+
+char* processStatsCommand(char *);      // "stats: [<interface> [lat] | reset]"
+
+
+/* ISR instrumentation.  Use ISR_STATS_ENTER() as the first statement of
+ * an ISR, and ISR_STATS_EXIT(interface) before every exit from it.
+ */
+
+#define ISR_STATS_ENTER() unsigned int isrStartCycles = TCNT1
+
+static inline void isrStatsExit(uint8_t interface, unsigned int cycles) {
+	linkStats *s = &linkStatistics[interface];
+	s->isrCount++;
+	s->isrCycles += cycles;
+	if (cycles > s->isrMaxCycles) s->isrMaxCycles = cycles;
+}
+
+#define ISR_STATS_EXIT(interface) isrStatsExit((interface), TCNT1 - isrStartCycles)
+
+static inline void statsHighWater(uint8_t *mark, uint8_t level) {
+	if (level > *mark) *mark = level;
+}
+
+#endif
@@ -0,0 +1,128 @@
+/* tjs_memory.c - SRAM usage and stack high-water measurement.
+ *
+ * The ATmega32U4 has 2.5 KB of SRAM.  The layout is:
+ *
+ *   __data_start .. _end     .data and .bss (static allocation)
+ *   _end .. SP               free (this code uses no heap)
+ *   SP .. __stack (RAMEND)   stack
+ *
+ * paintStack() runs in section .init1, before the stack pointer and
+ * __zero_reg__ are set up, so it is written in assembly and uses no
+ * stack.
+ *
+ * None of this means anything in the host build (see tjs_hal.h), where
+ * the figures are all reported as 0.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "tjs_hal.h"
+#include "tjs_memory.h"
+#include "tjs_progmem.h"
+#include "tjs_reply.h"
+
+#ifdef __AVR__
+
+extern uint8_t __data_start;            // start of .data (linker symbol)
+extern uint8_t _end;                    // end of .bss (linker symbol)
+extern uint8_t __stack;                 // top of stack (linker symbol)
+
+
+/* paintStack - paint _end .. __stack with STACK_PAINT.  Called by the C
+ * runtime startup code, never by the program.
+ */
+
+void paintStack(void) __attribute__ ((naked, used, section(".init1")));
+
+void paintStack(void) {
+	__asm volatile (
+		"    ldi r30, lo8(_end)     \n"
+		"    ldi r31, hi8(_end)     \n"
+		"    ldi r24, %0            \n"
+		"    ldi r25, hi8(__stack)  \n"
+		"    rjmp 2f                \n"
+		"1:  st Z+, r24             \n"
+		"2:  cpi r30, lo8(__stack)  \n"
+		"    cpc r31, r25           \n"
+		"    brlo 1b                \n"
+		"    breq 1b                \n"
+		:: "M" (STACK_PAINT));
+}
+
+
+
+/* sramStatic - bytes of SRAM used by .data and .bss.
+ */
+
+unsigned int sramStatic(void) {
+	return &_end - &__data_start;
+}
+
+
+
+/* sramFree - bytes of SRAM currently free, between the end of .bss and
+ * the stack pointer.
+ */
+
+unsigned int sramFree(void) {
+	uint8_t here;                       // approximately SP
+	return &here - &_end;
+}
+
+
+
+/* sramStackUnused - bytes above _end that still hold the paint, i.e. that
+ * the stack has never reached.  This is the worst-case headroom seen
+ * since reset.
+ */
+
+unsigned int sramStackUnused(void) {
+
+	const uint8_t *p = &_end;
+
+	while ((p <= &__stack) && (*p == STACK_PAINT)) p++;
+	return p - &_end;
+}
+
+
+
+/* sramTotal - bytes of SRAM.
+ */
+
+static unsigned int sramTotal(void) {
+	return &__stack - &__data_start + 1;
+}
+
+#else
+
+unsigned int sramStatic(void) { return 0; }
+unsigned int sramFree(void) { return 0; }
+unsigned int sramStackUnused(void) { return 0; }
+static unsigned int sramTotal(void) { return 0; }
+
+#endif
+
+
+
+/* processMemCommand - process "mem:" command.  Responds with:
+ *     "mem: <sram> <static> <free now> <never used> <stack max>"
+ * all in bytes.  <never used> is the headroom left at the deepest stack
+ * use since reset, and <stack max> is that deepest use.
+ * Note: this code is not reentrant.
+ */
+
+char* processMemCommand(char *command) {
+
+	const uint8_t size = 50;
+	char *string = replySlot(size);
+	unsigned int unused = sramStackUnused();
+	unsigned int total = sramTotal();
+
+	snprintf_P(string, size, PSTR("mem: %u %u %u %u %u\n"),
+	         total, sramStatic(), sramFree(), unused,
+	         total - sramStatic() - unused);
+	return string;
+}
@@ -0,0 +1,22 @@
+/* tjs_memory.h - SRAM usage and stack high-water measurement.
+ *
+ * At reset, before the C runtime initializes anything, the SRAM between
+ * the end of .data/.bss and the top of the stack is painted with a
+ * known pattern.  The stack high-water mark is then found by looking for
+ * the lowest address at which the pattern has been overwritten.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_MEMORY_H
+#define TJS_MEMORY_H
+
+#define STACK_PAINT 0xc5                // pattern painted on unused SRAM
+
+unsigned int sramStatic(void);          // bytes used by .data and .bss
+unsigned int sramFree(void);            // bytes free now (between .bss and stack pointer)
+unsigned int sramStackUnused(void);     // bytes never touched by the stack since reset
+
+char* processMemCommand(char *);        // "mem:"
+
+#endif
@@ -12,10 +12,12 @@
 
 
 #include <stdlib.h>
-#include <avr/io.h>
-#include <avr/interrupt.h>
 
+#include "tjs_hal.h"
 #include "tjs_leds.h"
+#include "tjs_msec_clock.h"
+#include "tjs_sched.h"
+#include "tjs_timer.h"
 
 
 /* 64-bit millisecond clock. */
@@ -37,9 +39,13 @@ void initializeMsecClock(void) {
 	
     TCCR4B |= (1 << CS42) | (1 << CS41) | (1 << CS40);  // set prescaler of 64
 	
+	/* Timer 4 counts 0..OCR4C, so OCR4C = 249 gives 250 ticks (of 4 usec)
+	 * per msec.  OCR4A is 0, so the compare match A interrupt occurs as
+	 * the count wraps to 0. */
+	
 //	OCR4A = 250;                        // compare value
 //	OCR4B = 250;
-	OCR4C = 250;
+	OCR4C = TIMESTAMP_TICKS_PER_MSEC - 1;
 //	OCR4D = 250;
 	
     TIMSK4 |= (1 << OCIE4A);
@@ -87,8 +93,8 @@ void startMsecClock() {
 
 /* getMsecClock() - get current millisecond clock value.
  *
- * Note: users should probably check whether a timer overflow interrupt
- * is pending, and adjust the values of cpu_clock_upper, as necessary.
+ * Note: this returns only the low 32 bits of the clock, which wrap after
+ * about 49 days.  Use getMsecClock64() for the full clock.
  */
 
 unsigned long int getMsecClock() {
@@ -104,16 +110,98 @@ unsigned long int getMsecClock() {
 }
 
 
+
+/* getMsecClock64() - get current millisecond clock value, all 64 bits.
+ */
+
+unsigned long long int getMsecClock64() {
+
+    unsigned char sreg;                 // save status register (interrupt state)
+    unsigned long long int temp;
+
+    sreg = SREG;	
+    cli();
+    temp = msec_clock;
+    SREG=sreg;
+    return temp;
+}
+
+
+
+/* getTimestamp() - get current time in 4 usec timer 4 ticks.
+ *
+ * The millisecond clock and TCNT4 are read with interrupts disabled.  If
+ * the count has wrapped to 0 but the compare match interrupt has not yet
+ * been serviced (interrupts are off, or we are in another ISR), the
+ * compare flag is still pending and msec_clock is one behind, so add one
+ * msec.  The flag is only trusted if TCNT4 is in the first half of the
+ * msec: if TCNT4 was read just before the wrap, and the flag was set just
+ * after, msec_clock is not behind.
+ *
+ * Safe to call from ISRs.
+ */
+
+unsigned long long int getTimestamp() {
+
+    unsigned char sreg;                 // save status register (interrupt state)
+    unsigned long long int msec;
+    unsigned char count;
+
+    sreg = SREG;	
+    cli();
+    msec = msec_clock;
+    count = TCNT4;                      // TOP < 256, so TC4H is always 0
+    if ((TIFR4 & (1 << OCF4A)) && (count < TIMESTAMP_TICKS_PER_MSEC/2)) {
+		msec++;                         // compare match pending
+	}
+    SREG=sreg;
+    return msec * TIMESTAMP_TICKS_PER_MSEC + count;
+}
+
+
+
+/* getTicks16() - get low 16 bits of getTimestamp().
+ *
+ * Cheaper than getTimestamp() (16-bit arithmetic only), so suitable for
+ * measuring short intervals (less than 262 msec) in ISRs.  Subtract two
+ * values with unsigned arithmetic to get an interval in 4 usec ticks.
+ */
+
+unsigned int getTicks16() {
+
+    unsigned char sreg;                 // save status register (interrupt state)
+    unsigned int msec;
+    unsigned char count;
+
+    sreg = SREG;	
+    cli();
+    msec = (unsigned int)msec_clock;
+    count = TCNT4;
+    if ((TIFR4 & (1 << OCF4A)) && (count < TIMESTAMP_TICKS_PER_MSEC/2)) {
+		msec++;                         // compare match pending
+	}
+    SREG=sreg;
+    return msec * TIMESTAMP_TICKS_PER_MSEC + count;
+}
+
+
 //ISR(TIMER0_COMPA_vect) {
 //    msec_clock++;
 //}
 	
 
 /* Timer4 Compare Match A ISR.
+ * Advances the msec clock, flags software timers that are due, and runs
+ * the LED status engine.
  */
  
 ISR(TIMER4_COMPA_vect) {
 	msec_clock++;                       // increment msec clock
+	ledsTick();                         // next LED frame, when due
+	if ((long)((unsigned long)msec_clock - timerNextExpiry) >= 0) {
+		timerExpired = 1;               // software timer due
+		postEventFromIsr(EVENT_TIMER);
+	}
 }
 	 
 
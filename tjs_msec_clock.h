@@ -1,6 +1,9 @@
 /* tjs_msec_clock.h - implement millisecond clock.
  *
- * The millisecond clock is incremented every millisecond by timer 0.
+ * The millisecond clock is incremented every millisecond by timer 4.
+ *
+ * getTimestamp() combines the millisecond clock with the timer 4 count,
+ * to give a 64-bit timestamp with 4 usec resolution.
  *
  * Copyright (C) Timothy J. Salo, 2018.
  */
@@ -8,4 +11,10 @@
 void initializeMsecClock(void);           // initialize millisecond clock
 void stopMsecClock(void);                 // stop millisecond clock
 void startMsecClock(void);                // stop millisecond clock
-unsigned long int getMsecClock(void);     // get current millisecond clock
+unsigned long int getMsecClock(void);     // get current millisecond clock (low 32 bits)
+unsigned long long int getMsecClock64(void);    // get current millisecond clock (64 bits)
+unsigned long long int getTimestamp(void);    // get current time, in 4 usec ticks
+unsigned int getTicks16(void);            // low 16 bits of getTimestamp(), for short intervals
+
+#define TIMESTAMP_TICKS_PER_MSEC 250      // timer 4 ticks per msec
+#define TIMESTAMP_USEC_PER_TICK 4         // usec per timer 4 tick
@@ -0,0 +1,110 @@
+/* tjs_parse.c - incremental command tokenizer, run by the receive ISRs.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tjs_cmdq.h"
+#include "tjs_hal.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+
+cmdParser cmdParsers[INTERFACES];
+uint16_t parseHashes[PARSE_COMMANDS];
+uint8_t parseBuckets[PARSE_BUCKETS];
+
+static char *argNext;                   // next argument of current command
+static char *argEnd;                    // end of current command
+
+
+
+/* parseRegister - add command index, name (in flash), to the hash table.
+ * Returns -1 if the table is full, or the name's hash is already taken.
+ */
+
+int parseRegister(uint8_t index, PGM_P name) {
+
+	uint16_t hash = PARSE_HASH_INIT;
+	uint8_t ch;
+
+	if (index >= PARSE_COMMANDS) return -1;
+	while ((ch = pgm_read_byte(name++)) != '\0') hash = parseHash(hash, ch);
+	if (parseLookup(hash) != CMD_UNKNOWN) return -1;
+
+	uint8_t b = hash & (PARSE_BUCKETS - 1);
+	while (parseBuckets[b] != 0) b = (b + 1) & (PARSE_BUCKETS - 1);
+
+	unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	parseHashes[index] = hash;
+	parseBuckets[b] = index + 1;
+	SREG = sreg;
+	return 0;
+}
+
+
+
+/* parseRescan - recompute a parser's state from the frame being received
+ * (after a backspace).  Called with interrupts disabled.
+ */
+
+void parseRescan(cmdParser *p, cmdQueue *q) {
+
+	const char *frame = &q->buffer[q->tail + 2];
+	uint8_t i;
+
+	parseInit(p);
+	for (i = 0; i < q->length; i++) {
+		if (frame[i] == '\0') {
+			p->words++;
+		} else if (p->words == 0) {
+			p->hash = parseHash(p->hash, frame[i]);
+		}
+	}
+	p->space = (q->length > 0) && (frame[q->length - 1] == '\0');
+}
+
+
+
+/* parseArgs - make the arguments of frame (length bytes, command name
+ * first) the ones nextArg() returns.
+ */
+
+void parseArgs(char *frame, uint8_t length) {
+	argEnd = frame + length;
+	argNext = frame + strlen(frame) + 1;
+}
+
+
+
+/* nextArg - return the next argument of the command being processed, or
+ * NULL if there are no more.  (Command processors use this where they
+ * would use strtok(NULL, " ").)
+ */
+
+char* nextArg(void) {
+
+	char *arg = argNext;
+
+	if (arg >= argEnd) return NULL;
+	argNext += strlen(arg) + 1;
+	return arg;
+}
+
+
+
+/* parsePrint - print prefix and frame (length bytes), with its tokens
+ * separated by spaces again.
+ */
+
+void parsePrint(PGM_P prefix, const char *frame, uint8_t length) {
+
+	uint8_t i;
+
+	printf_P(prefix);
+	for (i = 0; i < length; i++) putchar(frame[i] ? frame[i] : ' ');
+	putchar('\n');
+}
@@ -0,0 +1,144 @@
+/* tjs_parse.h - incremental command tokenizer, run by the receive ISRs.
+ *
+ * Each interface's receive ISR passes command bytes through parsePutChar()
+ * on their way into the command queue (see tjs_cmdq.h).  The tokenizer
+ * stores each space-separated token NUL-terminated (runs of spaces
+ * collapse, and leading and trailing spaces are dropped), and hashes the
+ * first token, the command name, as it arrives.  At the terminator,
+ * parseEndFrame() looks the hash up in a small open-addressed table of
+ * the registered commands, and queues the frame tagged with the command's
+ * index.  So by the time the main loop sees a frame, it is already split
+ * into arguments and its command is known: dispatch is a table index and
+ * one strcmp_P() (to rule out hash collisions with unregistered names),
+ * and nextArg() steps from one argument to the next.
+ *
+ * The ISR side (parseInit(), parsePutChar(), parseUnputChar(),
+ * parseDropFrame(), parseEndFrame()) is inline, and only called with
+ * interrupts disabled.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_PARSE_H
+#define TJS_PARSE_H
+
+#include <stdint.h>
+
+#include "tjs_cmdq.h"
+#include "tjs_interfaces.h"
+#include "tjs_progmem.h"
+
+#define PARSE_COMMANDS 25               // most commands registered
+#define PARSE_BUCKETS 32                // hash table size (power of 2)
+#define PARSE_HASH_INIT 5381            // hash of the empty command name
+#define CMD_UNKNOWN 0xff                // tag of a frame with no such command
+
+typedef struct {
+	uint16_t hash;                      // hash of command name so far
+	uint8_t words;                      // tokens ended so far
+	uint8_t space;                      // last char stored was a separator
+} cmdParser;
+
+extern cmdParser cmdParsers[INTERFACES];
+extern uint16_t parseHashes[PARSE_COMMANDS];    // hash of each command name
+extern uint8_t parseBuckets[PARSE_BUCKETS];     // command index + 1 (0: empty)
+
+int parseRegister(uint8_t index, PGM_P name);  // add command to hash table
+void parseRescan(cmdParser *, cmdQueue *);     // recompute state from frame
+void parseArgs(char *frame, uint8_t length);   // set up nextArg() for a frame
+char* nextArg(void);                    // next argument of command, or NULL
+void parsePrint(PGM_P prefix, const char *frame, uint8_t length);    // print frame as text
+
+
+/* parseInit - get ready for a new frame.
+ */
+
+static inline void parseInit(cmdParser *p) {
+	p->hash = PARSE_HASH_INIT;
+	p->words = 0;
+	p->space = 0;
+}
+
+
+
+/* parseHash - add ch to a command name hash.
+ */
+
+static inline uint16_t parseHash(uint16_t hash, uint8_t ch) {
+	return ((hash << 5) + hash) ^ ch;
+}
+
+
+
+/* parseLookup - return the index of the command whose name has this
+ * hash, or CMD_UNKNOWN.
+ */
+
+static inline uint8_t parseLookup(uint16_t hash) {
+
+	uint8_t b = hash & (PARSE_BUCKETS - 1);
+	uint8_t i;
+
+	while ((i = parseBuckets[b]) != 0) {
+		if (parseHashes[i - 1] == hash) return i - 1;
+		b = (b + 1) & (PARSE_BUCKETS - 1);
+	}
+	return CMD_UNKNOWN;
+}
+
+
+
+/* parsePutChar - add ch to the frame being received, as a token char or a
+ * separator.  Returns 0 if it does not fit (the frame will be dropped
+ * when it ends).
+ */
+
+static inline uint8_t parsePutChar(cmdParser *p, cmdQueue *q, char ch) {
+
+	if (ch == ' ') {
+		if (p->space || (q->length == 0)) return 1;    // collapse, or leading
+		p->space = 1;
+		p->words++;
+		return cmdqPutChar(q, '\0');
+	}
+	if (p->words == 0) p->hash = parseHash(p->hash, ch);
+	p->space = 0;
+	return cmdqPutChar(q, ch);
+}
+
+
+
+/* parseUnputChar - remove the last char of the frame being received
+ * (e.g., backspace).  Rare, so the state is simply recomputed.
+ */
+
+static inline void parseUnputChar(cmdParser *p, cmdQueue *q) {
+	cmdqUnputChar(q);
+	parseRescan(p, q);
+}
+
+
+
+/* parseDropFrame - discard the frame being received (e.g., bad CRC).
+ */
+
+static inline void parseDropFrame(cmdParser *p, cmdQueue *q) {
+	cmdqDropFrame(q);
+	parseInit(p);
+}
+
+
+
+/* parseEndFrame - end the frame being received, look up its command, and
+ * queue it.  Returns the queued frame, or NULL if it was dropped.
+ */
+
+static inline char* parseEndFrame(cmdParser *p, cmdQueue *q) {
+
+	if (p->space) cmdqUnputChar(q);     // trailing separator
+	char *frame = cmdqEndFrame(q, parseLookup(p->hash));
+	parseInit(p);
+	return frame;
+}
+
+#endif
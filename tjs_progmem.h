@@ -0,0 +1,50 @@
+/* tjs_progmem.h - constant strings and tables in flash (PROGMEM).
+ *
+ * avr-gcc copies all initialized data, including const strings, into
+ * SRAM at startup.  Data marked PROGMEM stays in flash, and is read with
+ * the pgm_read_*() macros and the *_P() string functions.
+ *
+ * Off the AVR (e.g., host tools that share firmware code), flash and
+ * SRAM are the same, so the macros fall back to the ordinary functions.
+ * A string in flash is printed with PGM_S ("%S" in avr-libc, "%s"
+ * elsewhere), e.g. printf_P(PSTR("x: " PGM_S "\n"), PSTR("on")).
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_PROGMEM_H
+#define TJS_PROGMEM_H
+
+#ifdef __AVR__
+
+#include <avr/pgmspace.h>
+
+#define PGM_S "%S"                      // printf conversion for a string in flash
+
+#else
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char *
+#define PGM_S "%s"
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_ptr(p) (*(void * const *)(p))
+#define strcmp_P strcmp
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define printf_P printf
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define strlcpy_P strlcpy
+#define strlcat_P strlcat
+
+#endif
+
+char* progmemReply(PGM_P);              // copy a constant reply out of flash (simpleSerial.c)
+
+#endif
@@ -0,0 +1,122 @@
+/* tjs_record.c - binary sample records, shared by the firmware and hosts.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tjs_history.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+#include "tjs_record.h"
+#include "tjs_reply.h"
+
+uint8_t recordBinary[INTERFACES];       // off: text, as before
+uint8_t recordReplyLength;
+
+static unsigned long lastTime[INTERFACES];    // time of last record sent
+static uint8_t timeValid[INTERFACES];   // a RECORD_TIME has been sent
+
+
+
+/* putRecord - encode one record at p, and return the end of it.
+ */
+
+static uint8_t* putRecord(uint8_t *p, uint8_t type, uint8_t flags,
+                          uint16_t seq, uint16_t a, uint16_t b) {
+	p[0] = RECORD_MARK | (RECORD_VERSION << 4) | type;
+	p[1] = flags;
+	p[2] = seq;
+	p[3] = seq >> 8;
+	p[4] = a;
+	p[5] = a >> 8;
+	p[6] = b;
+	p[7] = b >> 8;
+	return p + RECORD_LENGTH;
+}
+
+
+
+/* recordSample - encode the latest sample for an interface in buffer
+ * (RECORD_MAX bytes): a RECORD_TEMP, preceded by a RECORD_TIME if the
+ * interface needs one.  Returns the length.
+ */
+
+uint8_t recordSample(uint8_t interface, uint8_t *buffer, int16_t value,
+                     unsigned long time, uint8_t flags) {
+
+	uint16_t seq = historyNextSeq() - 1;
+	unsigned long delta = time - lastTime[interface];
+	uint8_t *p = buffer;
+
+	if (!timeValid[interface] || (delta > 0xffff)) {
+		p = putRecord(p, RECORD_TIME, 0, seq, time, time >> 16);
+		delta = 0;
+		timeValid[interface] = 1;
+	}
+	lastTime[interface] = time;
+	p = putRecord(p, RECORD_TEMP, flags, seq, delta, value);
+	return p - buffer;
+}
+
+
+
+/* recordDropped - note that the last record encoded for an interface was
+ * not sent.  Its time is not the host's time base, so the next record is
+ * preceded by a RECORD_TIME.
+ */
+
+void recordDropped(uint8_t interface) {
+	timeValid[interface] = 0;
+}
+
+
+
+/* recordReply - return the latest sample as a binary reply to a command,
+ * and set recordReplyLength.  The transport sends recordReplyLength bytes
+ * (instead of a string), and clears it.
+ */
+
+char* recordReply(int16_t value, unsigned long time, uint8_t flags) {
+
+	char *reply = replySlot(RECORD_MAX);
+
+	recordReplyLength = recordSample(commandInterface, (uint8_t *)reply, value, time, flags);
+	return reply;
+}
+
+
+
+/* processBinaryCommand - process "binary: [on | off]" command, for the
+ * interface the command arrived on.  "on" also resets the interface's
+ * time, so the next record is preceded by a RECORD_TIME.  Responds (in
+ * text) with "binary: <if> <on|off>".
+ * Note: this code is not reentrant.
+ */
+
+char* processBinaryCommand(char *command) {
+
+	const uint8_t size = 20;
+	char *string = replySlot(size);
+	char name[INTERFACE_NAME_LENGTH];
+	uint8_t i = commandInterface;
+	char* token = nextArg();             // grab possible on/off
+
+	if (token == NULL) {
+		;                               // report only
+	} else if (strcmp_P(token, PSTR("on")) == 0) {
+		recordBinary[i] = 1;
+		timeValid[i] = 0;
+	} else if (strcmp_P(token, PSTR("off")) == 0) {
+		recordBinary[i] = 0;
+	} else {
+		return progmemReply(PSTR("nack:\n"));
+	}
+
+	strcpy_P(name, interfaceNames[i]);
+	snprintf_P(string, size, PSTR("binary: %s " PGM_S "\n"),
+	         name, recordBinary[i] ? PSTR("on") : PSTR("off"));
+	return string;
+}
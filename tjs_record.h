@@ -0,0 +1,53 @@
+/* tjs_record.h - binary sample records, shared by the firmware and hosts.
+ *
+ * In binary mode ("binary: on"), readings leave the board as fixed-size
+ * 8-byte records instead of "temp:" text.  All multi-byte fields are
+ * little-endian:
+ *
+ *     byte 0     RECORD_MARK | (RECORD_VERSION << 4) | type
+ *     byte 1     flags (RECORD_FLAG_*)
+ *     bytes 2-3  seq: history sequence number of the sample
+ *     bytes 4-7  RECORD_TEMP: msec since the previous record (uint16),
+ *                             then the value, in 0.1 degrees C (int16)
+ *                RECORD_TIME: msec clock (uint32)
+ *
+ * Byte 0 has the top bit set, and text from the board never does, so a
+ * host can tell records from text on a shared stream (the async link).
+ * Records may contain any byte, including NUL and '\n'.  A RECORD_TIME
+ * record sets the time on an interface: it comes first in binary mode,
+ * whenever the time since the last record does not fit in 16 bits, and
+ * after a pushed record was dropped because the link was busy.
+ *
+ * The Android app decodes records with SampleRecord.java, which mirrors
+ * this layout; change both together, and bump RECORD_VERSION.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_RECORD_H
+#define TJS_RECORD_H
+
+#include <stdint.h>
+
+#include "tjs_interfaces.h"
+
+#define RECORD_MARK 0x80                // set in byte 0 of every record
+#define RECORD_VERSION 1                // layout version (3 bits)
+#define RECORD_LENGTH 8                 // bytes per record
+#define RECORD_MAX (2 * RECORD_LENGTH)  // most bytes for one sample (TIME, TEMP)
+
+#define RECORD_TEMP 1                   // temperature sample
+#define RECORD_TIME 2                   // absolute time
+
+#define RECORD_FLAG_SAME 0x01           // deadband: unchanged since last sent
+
+extern uint8_t recordBinary[INTERFACES];    // interface is in binary mode
+extern uint8_t recordReplyLength;       // length of binary reply (0: text)
+
+uint8_t recordSample(uint8_t interface, uint8_t *buffer, int16_t value,
+                     unsigned long time, uint8_t flags);    // encode, return length
+void recordDropped(uint8_t interface);  // last record not sent: resend the time
+char* recordReply(int16_t value, unsigned long time, uint8_t flags);    // binary command reply
+char* processBinaryCommand(char *);     // "binary: [on | off]"
+
+#endif
@@ -0,0 +1,189 @@
+/* tjs_reliable.c - sliding-window reliable delivery on the async link.
+ *
+ * Record format:
+ *     "rel: <seq> <time> <value>"
+ * <seq> counts from 0 each time reliable mode is turned on, modulo 65536.
+ * <time> is the msec clock of the sample, <value> degrees C.
+ *
+ * Records are numbered when they are put, kept in records[] (indexed by
+ * seq modulo RELIABLE_RECORDS) until acknowledged, and sent while fewer
+ * than <window> are outstanding.  If the host stops acknowledging, and
+ * records[] fills, new readings are dropped (and counted) without being
+ * numbered, so the sequence has no gaps; "send: temp since" can fetch
+ * the missed samples from the history.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "simpleSerial.h"
+#include "tjs_msec_clock.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+#include "tjs_reliable.h"
+#include "tjs_reply.h"
+#include "tjs_timer.h"
+
+int reliableEnabled = 0;                // off: push "temp:" lines, as before
+
+static reliableRecord records[RELIABLE_RECORDS];
+static uint16_t base;                   // oldest unacknowledged record
+static uint16_t sendSeq;                // next record to send
+static uint16_t nextSeq;                // number of next record put
+static uint8_t window = 8;              // max records unacknowledged
+static unsigned int rto = 250;          // retransmit timeout (msec)
+static unsigned long sentAt;            // msec clock when base was last sent
+static int tickTimer = -1;              // retransmit check timer
+static unsigned int retransmits;        // records sent again
+static unsigned int overflows;          // readings dropped, records[] full
+
+
+
+/* sendRecord - send record seq.
+ */
+
+static void sendRecord(uint16_t seq) {
+
+	reliableRecord *r = &records[seq % RELIABLE_RECORDS];
+	unsigned int v = (r->value < 0) ? -r->value : r->value;
+
+	uint8_t old = uart_set_class(UART_TELEMETRY);
+	printf_P(PSTR("rel: %u %lu " PGM_S "%u.%u\n"), seq, r->time,
+	         (r->value < 0) ? PSTR("-") : PSTR(""), v / 10, v % 10);
+	uart_set_class(old);
+}
+
+
+
+/* sendWindow - send the records that are waiting, while the window has
+ * room.
+ */
+
+static void sendWindow(void) {
+
+	while ((sendSeq != nextSeq) && ((uint16_t)(sendSeq - base) < window)) {
+		if (sendSeq == base) sentAt = getMsecClock();
+		sendRecord(sendSeq++);
+	}
+}
+
+
+
+/* reliableTick - go back to the oldest unacknowledged record if it has
+ * waited rto msec.  Runs every RELIABLE_TICK msec while reliable mode is
+ * on.
+ */
+
+static void reliableTick(void) {
+
+	if (base == sendSeq) return;        // nothing outstanding
+	if (getMsecClock() - sentAt < rto) return;
+
+	retransmits += (uint16_t)(sendSeq - base);
+	sendSeq = base;
+	sendWindow();
+}
+
+
+
+/* reliablePut - number a reading, keep it until it is acknowledged, and
+ * send it if the window has room.
+ */
+
+void reliablePut(int16_t value, unsigned long time) {
+
+	if ((uint16_t)(nextSeq - base) >= RELIABLE_RECORDS) {
+		overflows++;
+		return;
+	}
+	reliableRecord *r = &records[nextSeq % RELIABLE_RECORDS];
+	r->value = value;
+	r->time = time;
+	nextSeq++;
+	sendWindow();
+}
+
+
+
+/* processReliableCommand - process "reliable: [on [<window> [<rto>]] | off]"
+ * command.  "on" restarts the sequence at 0; <window> is 1 to
+ * RELIABLE_RECORDS records, <rto> in msec.  Responds with
+ *     "reliable: <on|off> <window> <rto> <next seq> <unacked> <retransmits> <overflows>"
+ * Note: this code is not reentrant.
+ */
+
+char* processReliableCommand(char *command) {
+
+	const uint8_t size = 60;
+	char *string = replySlot(size);
+	char* token = nextArg();             // grab possible parameter
+
+	if (token == NULL) {
+		;                               // report only
+	} else if (strcmp_P(token, PSTR("on")) == 0) {
+		unsigned long w = window;
+		unsigned long t = rto;
+		token = nextArg();               // grab possible <window>
+		if (token != NULL) {
+			w = strtoul(token, NULL, 10);
+			token = nextArg();           // grab possible <rto>
+			if (token != NULL) t = strtoul(token, NULL, 10);
+		}
+		if ((w < 1) || (w > RELIABLE_RECORDS) || (t < RELIABLE_TICK) || (t > 60000)) {
+			return progmemReply(PSTR("nack:\n"));
+		}
+		window = w;
+		rto = t;
+		if (!reliableEnabled) {
+			base = sendSeq = nextSeq = 0;
+			retransmits = overflows = 0;
+			tickTimer = timerStart(reliableTick, RELIABLE_TICK, RELIABLE_TICK);
+			reliableEnabled = 1;
+		}
+	} else if (strcmp_P(token, PSTR("off")) == 0) {
+		if (reliableEnabled) timerStop(tickTimer);
+		base = sendSeq = nextSeq;       // discard unacknowledged records
+		reliableEnabled = 0;
+	} else {
+		return progmemReply(PSTR("nack:\n"));
+	}
+
+	snprintf_P(string, size, PSTR("reliable: " PGM_S " %u %u %u %u %u %u\n"),
+	         reliableEnabled ? PSTR("on") : PSTR("off"), window, rto, nextSeq,
+	         (uint16_t)(nextSeq - base), retransmits, overflows);
+	return string;
+}
+
+
+
+/* processRackCommand - process "rack: <seq>" command: the host has
+ * received every record before <seq>.  Acknowledged records are freed,
+ * and the window moves on.  No reply, and no echo (it is registered with
+ * registerQuietCommand()), so acks cost no output; an ack for records
+ * that do not exist yet is answered with "nack:".
+ */
+
+char* processRackCommand(char *command) {
+
+	char* token = nextArg();             // grab <seq>
+
+	if (token == NULL) return progmemReply(PSTR("nack:\n"));
+	uint16_t seq = strtoul(token, NULL, 10);
+
+	if ((uint16_t)(seq - base) > (uint16_t)(nextSeq - base)) {
+		return progmemReply(PSTR("nack:\n"));
+	}
+	if (seq != base) {
+		if ((uint16_t)(seq - base) > (uint16_t)(sendSeq - base)) {
+			sendSeq = seq;              // ack from before a go-back
+		}
+		base = seq;
+		sentAt = getMsecClock();        // restart timeout for new oldest
+	}
+	sendWindow();
+	return NULL;
+}
@@ -0,0 +1,34 @@
+/* tjs_reliable.h - sliding-window reliable delivery on the async link.
+ *
+ * With "reliable: on", pushed temperature readings are sent as numbered
+ * "rel:" records instead of "temp:" lines.  The host acknowledges them
+ * cumulatively with "rack: <seq>" (everything before <seq> received), and
+ * the records not yet acknowledged are kept, so any that were lost (noise,
+ * host RX overrun, a dropped telemetry line) can be sent again.  Up to
+ * <window> records may be unacknowledged at once, so the host does not
+ * need a round trip per record.  After <rto> msec without an
+ * acknowledgement, every unacknowledged record is sent again (go-back-N).
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_RELIABLE_H
+#define TJS_RELIABLE_H
+
+#include <stdint.h>
+
+#define RELIABLE_RECORDS 16             // records kept until acknowledged (max window)
+#define RELIABLE_TICK 50                // msec between retransmit checks
+
+typedef struct {
+	unsigned long time;                 // msec clock of sample
+	int16_t value;                      // 0.1 degrees C
+} reliableRecord;
+
+extern int reliableEnabled;             // push "rel:" records, rather than "temp:" lines
+
+void reliablePut(int16_t value, unsigned long time);    // number, keep and send a record
+char* processReliableCommand(char *);   // "reliable: [on [<window> [<rto>]] | off]"
+char* processRackCommand(char *);       // "rack: <seq>"
+
+#endif
@@ -0,0 +1,89 @@
+/* tjs_reply.c - command replies, built in place in the transport.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "simpleSerial.h"
+#include "tjs_config.h"
+#include "tjs_interfaces.h"
+#include "tjs_reply.h"
+#include "tjsI2cSlave.h"
+#include "tjsSpiSlave.h"
+
+static char scratch[REPLY_MAX];         // reply, when there is no room in place
+static char *slot;                      // slot of the command being processed
+static uint8_t slotSize;
+
+
+
+/* replySlot - return a buffer of at least need bytes (at most REPLY_MAX)
+ * for the reply to the command being processed.  Calling it again for
+ * the same command returns the same buffer, if it is big enough.
+ */
+
+char* replySlot(uint8_t need) {
+
+	if ((slot != NULL) && (need <= slotSize)) return slot;
+
+	if (need > REPLY_MAX) need = REPLY_MAX;
+	slot = NULL;
+	slotSize = REPLY_MAX;
+	switch (commandInterface) {
+	case INTERFACE_ASYNC:
+		slot = uart_reserve(need);
+		slotSize = need;
+		break;
+#if CONFIG_I2C
+	case INTERFACE_I2C:
+		slot = i2cReserve();
+		break;
+#endif
+#if CONFIG_SPI
+	case INTERFACE_SPI:
+		slot = spiReserve();
+		break;
+#endif
+	}
+	if (slot == NULL) {
+		slot = scratch;
+		slotSize = REPLY_MAX;
+	}
+	return slot;
+}
+
+
+
+/* replySend - send reply (length bytes; binary, or text) to the command
+ * just processed, on interface.  A reply built in its slot is committed
+ * where it is; any other reply is copied.  NULL means no reply.
+ */
+
+void replySend(uint8_t interface, const char *reply, uint8_t length, uint8_t binary) {
+
+	uint8_t inPlace = (reply != NULL) && (reply == slot) && (slot != scratch);
+
+	slot = NULL;
+	if (reply == NULL) return;
+
+	switch (interface) {
+	case INTERFACE_ASYNC:
+		if (inPlace) uart_commit(length);
+		else if (binary) uart_write_record((const uint8_t *)reply, length);
+		else fputs(reply, stdout);
+		break;
+#if CONFIG_I2C
+	case INTERFACE_I2C:
+		i2cSetReply(reply, length, binary);     // not copied if in place
+		break;
+#endif
+#if CONFIG_SPI
+	case INTERFACE_SPI:
+		spiSetReply(reply, length, binary);
+		break;
+#endif
+	}
+}
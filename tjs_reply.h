@@ -0,0 +1,31 @@
+/* tjs_reply.h - command replies, built in place in the transport.
+ *
+ * A command processor gets the buffer for its reply from replySlot(),
+ * formats the reply into it, and returns it.  The slot is space in the
+ * transmit side of the interface the command arrived on: the free end of
+ * the async control queue, or the I2C (or SPI) reply buffer that is not
+ * being read.  replySend() then hands the reply to the transport with
+ * one index (or pointer) update, instead of copying it.
+ *
+ * If the transport has no room for the reply in place (the async queue
+ * is still draining earlier output), replySlot() returns a shared scratch
+ * buffer, and replySend() copies the reply, as before.  Replies returned
+ * from elsewhere (e.g., tempString) are copied, too.
+ *
+ * Nothing may be printed on the async control queue between
+ * replySlot() and replySend(): that output would land in the slot.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_REPLY_H
+#define TJS_REPLY_H
+
+#include <stdint.h>
+
+#define REPLY_MAX 100                   // longest reply, with its NUL
+
+char* replySlot(uint8_t need);          // buffer of at least need bytes for the reply
+void replySend(uint8_t interface, const char *reply, uint8_t length, uint8_t binary);    // send reply
+
+#endif
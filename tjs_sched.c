@@ -0,0 +1,139 @@
+/* tjs_sched.c - event-driven cooperative scheduler.
+ *
+ * Replaces the busy main loop, which polled every ready flag and
+ * deadline on every pass.  Tasks run to completion with interrupts
+ * enabled.  After each task, the scheduler looks again for the highest
+ * priority pending event, so a high priority event posted while a low
+ * priority task runs is served next.
+ *
+ * Wake-to-dispatch latency (from the first post of an event to the start
+ * of its task) is measured with getTicks16().  "sched: idle off" turns
+ * off idle sleep, so the latency can be compared with busy polling.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tjs_hal.h"
+#include "tjs_msec_clock.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+#include "tjs_reply.h"
+#include "tjs_sched.h"
+
+
+volatile uint8_t schedEvents = 0;
+volatile unsigned int schedPostTicks[EVENTS];
+unsigned int schedCurrentPostTicks;
+
+static schedTask tasks[EVENTS];
+static uint8_t idleSleep = 1;           // sleep when idle (0: busy poll)
+
+/* Wake-to-dispatch latency, in 4 usec ticks. */
+
+static unsigned long dispatches = 0;
+static unsigned long latencySum = 0;
+static unsigned int latencyMax = 0;
+
+
+/* schedRegister - register the task run for event.
+ */
+
+void schedRegister(uint8_t event, schedTask task) {
+	if (event < EVENTS) tasks[event] = task;
+}
+
+
+
+/* postEvent - post event from non-interrupt code.
+ */
+
+void postEvent(uint8_t event) {
+	unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	postEventFromIsr(event);
+	SREG = sreg;
+}
+
+
+
+/* schedRun - run tasks forever.
+ */
+
+void schedRun(void) {
+
+	set_sleep_mode(SLEEP_MODE_IDLE);    // peripherals and timers keep running
+
+	while (1) {
+
+		/* Sleep until an event is pending.  Interrupts are enabled by the
+		 * instruction just before "sleep", so an interrupt that arrives
+		 * after the test cannot be missed. */
+
+		cli();
+		if (schedEvents == 0) {
+			if (idleSleep) {
+				sleep_enable();
+				sei();
+				sleep_cpu();
+				sleep_disable();
+			}
+			sei();
+			continue;
+		}
+
+		/* Take the highest priority pending event. */
+
+		uint8_t events = schedEvents;
+		uint8_t event = 0;
+		while (!(events & (1 << event))) event++;
+		schedEvents = events & ~(1 << event);
+		schedCurrentPostTicks = schedPostTicks[event];
+		unsigned int latency = getTicks16() - schedCurrentPostTicks;
+		sei();
+
+		dispatches++;
+		latencySum += latency;
+		if (latency > latencyMax) latencyMax = latency;
+
+		if (tasks[event] != NULL) tasks[event]();
+	}
+}
+
+
+
+/* processSchedCommand - process "sched: [idle on | idle off | reset]".
+ * Responds with:
+ *     "sched: <idle|busy> <dispatches> <mean usec> <max usec>"
+ * Note: this code is not reentrant.
+ */
+
+char* processSchedCommand(char *command) {
+
+	const uint8_t size = 50;
+	char *string = replySlot(size);
+	char* token = nextArg();
+
+	if (token != NULL) {
+		if (strcmp_P(token, PSTR("reset")) == 0) {
+			dispatches = 0;
+			latencySum = 0;
+			latencyMax = 0;
+		} else if (strcmp_P(token, PSTR("idle")) == 0) {
+			token = nextArg();
+			if (token == NULL) return progmemReply(PSTR("nack:\n"));
+			idleSleep = (strcmp_P(token, PSTR("off")) != 0);
+		} else {
+			return progmemReply(PSTR("nack:\n"));
+		}
+	}
+
+	unsigned long mean = dispatches ? (latencySum * TIMESTAMP_USEC_PER_TICK) / dispatches : 0;
+	snprintf_P(string, size, PSTR("sched: " PGM_S " %lu %lu %lu\n"),
+	         idleSleep ? PSTR("idle") : PSTR("busy"), dispatches, mean,
+	         (unsigned long)latencyMax * TIMESTAMP_USEC_PER_TICK);
+	return string;
+}
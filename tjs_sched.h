@@ -0,0 +1,53 @@
+/* tjs_sched.h - event-driven cooperative scheduler.
+ *
+ * ISRs post events (bits in schedEvents).  schedRun() runs the task
+ * registered for each pending event, highest priority (lowest event
+ * number) first, and puts the CPU in idle sleep when no event is
+ * pending.  Any interrupt wakes the CPU.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_SCHED_H
+#define TJS_SCHED_H
+
+#include <stdint.h>
+
+#include "tjs_hal.h"
+
+/* Events, in priority order (0 = highest). */
+
+#define EVENT_I2C_COMMAND 0             // command received on I2C interface
+#define EVENT_SPI_COMMAND 1             // command received on SPI interface
+#define EVENT_ASYNC_COMMAND 2           // command received on async interface
+#define EVENT_TIMER 3                   // software timer expired
+#define EVENT_DEBUG 4                   // debug message ready to print
+#define EVENTS 8
+
+typedef void (*schedTask)(void);
+
+extern volatile uint8_t schedEvents;    // pending events
+extern volatile unsigned int schedPostTicks[EVENTS];    // time each event was first posted
+extern unsigned int schedCurrentPostTicks;    // post time of event whose task is running
+
+void schedRegister(uint8_t event, schedTask task);    // set task for event
+void schedRun(void);                    // run tasks forever
+void postEvent(uint8_t event);          // post event (not from ISRs)
+
+char* processSchedCommand(char *);      // "sched: [idle on | idle off | reset]"
+
+
+/* postEventFromIsr - post event from an ISR (interrupts already off).
+ * Records the time of the first post, for wake-to-dispatch latency.
+ */
+
+unsigned int getTicks16(void);
+
+static inline void postEventFromIsr(uint8_t event) {
+	if (!(schedEvents & (1 << event))) {
+		schedPostTicks[event] = getTicks16();
+		schedEvents |= (1 << event);
+	}
+}
+
+#endif
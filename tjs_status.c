@@ -0,0 +1,84 @@
+/* tjs_status.c - boot status: reset cause and startup times.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tjs_hal.h"
+#include "tjs_msec_clock.h"
+#include "tjs_progmem.h"
+#include "tjs_reply.h"
+#include "tjs_status.h"
+
+uint8_t statusResetCause;
+unsigned long statusReadyTicks;
+unsigned long statusFirstSampleTicks;
+
+/* Reset causes, in MCUSR bit order (PORF .. JTRF). */
+
+static const char resetNames[5][4] PROGMEM = {"por", "ext", "bod", "wdt", "jtg"};
+
+
+
+/* statusInit - save and clear the reset cause.  MCUSR must be cleared
+ * so the next reset reports only its own cause.  After a watchdog reset
+ * the watchdog is still running, and clearing WDRF lets it reset the
+ * board again, so turn it off; nothing here services it.
+ */
+
+void statusInit(void) {
+	statusResetCause = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+}
+
+
+
+/* statusReady - record when the transports and scheduler are up.
+ */
+
+void statusReady(void) {
+	statusReadyTicks = getTimestamp();
+}
+
+
+
+/* statusSample - record when the first temperature sample was taken.
+ * Cheap enough to call on every sample.
+ */
+
+void statusSample(void) {
+	if (statusFirstSampleTicks == 0) statusFirstSampleTicks = getTimestamp();
+}
+
+
+
+/* processStatusCommand - process "status:" command.  Responds with:
+ *     "status: <reset> <ready> <first sample> <uptime>"
+ * <reset> is the reset cause (por, ext, bod, wdt or jtg, or "-" if the
+ * bootloader cleared MCUSR), <ready> and <first sample> are usec after
+ * reset, and <uptime> is msec.
+ * Note: this code is not reentrant.
+ */
+
+char* processStatusCommand(char *command) {
+
+	const uint8_t size = 50;
+	char *string = replySlot(size);
+	char cause[sizeof(resetNames[0])] = "-";
+	uint8_t i;
+
+	for (i = 0; i < 5; i++) {
+		if (statusResetCause & (1 << i)) {
+			strcpy_P(cause, resetNames[i]);
+			break;
+		}
+	}
+	snprintf_P(string, size, PSTR("status: %s %lu %lu %lu\n"), cause,
+	           statusReadyTicks * TIMESTAMP_USEC_PER_TICK,
+	           statusFirstSampleTicks * TIMESTAMP_USEC_PER_TICK, getMsecClock());
+	return string;
+}
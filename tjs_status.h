@@ -0,0 +1,25 @@
+/* tjs_status.h - boot status: reset cause and startup times.
+ *
+ * main() records when the transports were ready and when the first
+ * temperature sample was taken, in 4 usec timestamp ticks from the
+ * start of the millisecond clock (the first thing main() does after
+ * reset).  "status:" reports them on any interface.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_STATUS_H
+#define TJS_STATUS_H
+
+#include <stdint.h>
+
+extern uint8_t statusResetCause;        // MCUSR at reset (0 if the bootloader cleared it)
+extern unsigned long statusReadyTicks;  // transports and scheduler up
+extern unsigned long statusFirstSampleTicks;    // first temperature sample (0: none yet)
+
+void statusInit(void);                  // save and clear the reset cause
+void statusReady(void);                 // record transports-ready time
+void statusSample(void);                // record first-sample time
+char* processStatusCommand(char *);     // "status:"
+
+#endif
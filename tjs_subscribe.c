@@ -0,0 +1,200 @@
+/* tjs_subscribe.c - subscriptions: records pushed on the async link.
+ *
+ * Record format:
+ *     "pub: <id> <stream> <seq> <time> <data>"
+ * <time> is the msec clock of the sample.  <data> is "<value>" (degrees
+ * C) for temp, and "<count> <min> <max> <mean>" (0.1 degrees C) of the
+ * last completed window 0 for agg.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "simpleSerial.h"
+#include "tjs_hal.h"
+#include "tjs_msec_clock.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+#include "tjs_reply.h"
+#include "tjs_subscribe.h"
+#include "tjs_window.h"
+
+static subscription subscriptions[SUBSCRIPTIONS];
+
+static const char streamNames[STREAMS][5] PROGMEM = {"temp", "agg"};
+
+
+
+/* findStream - return the stream named name, or -1.
+ */
+
+static int findStream(const char *name) {
+
+	uint8_t i;
+
+	for (i = 0; i < STREAMS; i++) {
+		if (strcmp_P(name, streamNames[i]) == 0) return i;
+	}
+	return -1;
+}
+
+
+
+/* publish - push one record for subscription id.
+ */
+
+static void publish(uint8_t id, int16_t value, unsigned long now) {
+
+	subscription *s = &subscriptions[id];
+	char name[sizeof(streamNames[0])];
+
+	uint8_t old = uart_set_class(UART_TELEMETRY);
+	strcpy_P(name, streamNames[s->stream]);
+	printf_P(PSTR("pub: %u %s %u %lu "), id, name, s->seq++, now);
+
+	if (s->stream == STREAM_TEMP) {
+		unsigned int v = (value < 0) ? -value : value;
+		printf_P(PSTR(PGM_S "%u.%u\n"), (value < 0) ? PSTR("-") : PSTR(""), v / 10, v % 10);
+	} else {
+		const windowStats *w = &windowAt(0)->last;
+		printf_P(PSTR("%u %d %d %ld\n"), w->count, w->min, w->max,
+		         (long)(w->mean >> WINDOW_MEAN_SHIFT));
+	}
+	uart_set_class(old);
+}
+
+
+
+/* subscribeSample - push the records that are due.  Called each time a
+ * sample is taken, after the window statistics are updated.
+ */
+
+void subscribeSample(int16_t value, unsigned long now) {
+
+	uint8_t i;
+
+	for (i = 0; i < SUBSCRIPTIONS; i++) {
+		subscription *s = &subscriptions[i];
+		if (!s->active) continue;
+
+		if (s->period != 0) {
+			if ((long)(now - s->next) < 0) continue;
+			s->next += s->period;       // drift-free, as for timers
+			if ((long)(now - s->next) >= 0) s->next = now + s->period;    // fell behind
+		} else if (s->stream == STREAM_TEMP) {
+			if ((s->seq != 0) && (value == s->lastValue)) continue;
+			s->lastValue = value;
+		} else {
+			unsigned long start = windowAt(0)->start;
+			if ((s->seq != 0) && (start == s->lastWindow)) continue;
+			s->lastWindow = start;
+		}
+		publish(i, value, now);
+	}
+}
+
+
+
+/* processSubscribeCommand - process "subscribe: [<stream> <period | change>]"
+ * command.
+ *
+ * With a stream, starts a subscription and responds with
+ *     "sub: <id> <stream> <period>"
+ * (<period> 0 means on change).  With no parameters, lists the active
+ * subscriptions as "sub: <id>:<stream>:<period> ...".
+ * Note: this code is not reentrant.
+ */
+
+char* processSubscribeCommand(char *command) {
+
+	const uint8_t size = 90;
+	char *string = replySlot(size);
+	char name[sizeof(streamNames[0])];
+	char* token = nextArg();             // grab possible <stream>
+	uint8_t i;
+
+	if (token == NULL) {
+		int n = snprintf_P(string, size, PSTR("sub:"));
+		for (i = 0; i < SUBSCRIPTIONS; i++) {
+			subscription *s = &subscriptions[i];
+			if (!s->active) continue;
+			strcpy_P(name, streamNames[s->stream]);
+			n += snprintf_P(&string[n], size - n, PSTR(" %u:%s:%lu"),
+			                i, name, s->period);
+		}
+		strlcat_P(string, PSTR("\n"), size);
+		return string;
+	}
+
+	int stream = findStream(token);
+	token = nextArg();                   // grab <period | change>
+	if ((stream < 0) || (token == NULL)) return progmemReply(PSTR("nack:\n"));
+
+	unsigned long period = 0;
+	if (strcmp_P(token, PSTR("change")) != 0) {
+		period = strtoul(token, NULL, 10);
+		if (period == 0) return progmemReply(PSTR("nack:\n"));
+	}
+
+	for (i = 0; i < SUBSCRIPTIONS; i++) {
+		if (!subscriptions[i].active) break;
+	}
+	if (i == SUBSCRIPTIONS) return progmemReply(PSTR("nack: full\n"));
+
+	subscription *s = &subscriptions[i];
+	s->stream = stream;
+	s->period = period;
+	s->next = getMsecClock();           // first record at the next sample
+	s->seq = 0;
+	s->active = 1;
+
+	strcpy_P(name, streamNames[stream]);
+	snprintf_P(string, size, PSTR("sub: %u %s %lu\n"), i, name, period);
+	return string;
+}
+
+
+
+/* processUnsubscribeCommand - process "unsubscribe: [<id> | <stream>]"
+ * command.  Stops subscription <id>, all subscriptions to <stream>, or,
+ * with no parameter, all subscriptions.  Responds with "unsub: <count>",
+ * the number stopped.
+ * Note: this code is not reentrant.
+ */
+
+char* processUnsubscribeCommand(char *command) {
+
+	const uint8_t size = 20;
+	char *string = replySlot(size);
+	char* token = nextArg();             // grab possible <id> or <stream>
+	int stream = -1;
+	int id = -1;
+	uint8_t count = 0;
+	uint8_t i;
+
+	if (token != NULL) {
+		stream = findStream(token);
+		if (stream < 0) {
+			char *end;
+			id = strtol(token, &end, 10);
+			if ((*end != '\0') || (id < 0) || (id >= SUBSCRIPTIONS)) {
+				return progmemReply(PSTR("nack:\n"));
+			}
+		}
+	}
+
+	for (i = 0; i < SUBSCRIPTIONS; i++) {
+		subscription *s = &subscriptions[i];
+		if (!s->active) continue;
+		if ((id >= 0) && (i != id)) continue;
+		if ((stream >= 0) && (s->stream != stream)) continue;
+		s->active = 0;
+		count++;
+	}
+	snprintf_P(string, size, PSTR("unsub: %u\n"), count);
+	return string;
+}
@@ -0,0 +1,40 @@
+/* tjs_subscribe.h - subscriptions: records pushed on the async link.
+ *
+ * "subscribe: <stream> <period | change>" asks for a stream to be pushed
+ * every <period> msec, or whenever it changes, with no request for each
+ * record.  Several subscriptions, with different periods, may be active
+ * at once.  Records are "pub:" lines, tagged with the subscription id and
+ * stream and numbered per subscription, so the host can see gaps.
+ *
+ * Streams are evaluated when a sample is taken, so the shortest useful
+ * period is the sample period (tempPeriod, 100 msec).
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_SUBSCRIBE_H
+#define TJS_SUBSCRIBE_H
+
+#include <stdint.h>
+
+#define SUBSCRIPTIONS 4                 // max concurrent subscriptions
+
+#define STREAM_TEMP 0                   // latest temperature
+#define STREAM_AGG 1                    // last completed window 0 ("agg: 0")
+#define STREAMS 2
+
+typedef struct {
+	uint8_t active;
+	uint8_t stream;                     // STREAM_*
+	unsigned long period;               // msec between records (0: on change)
+	unsigned long next;                 // msec clock of next record
+	uint16_t seq;                       // sequence number of next record
+	int16_t lastValue;                  // last temperature pushed (on change)
+	unsigned long lastWindow;           // start of last window pushed (on change)
+} subscription;
+
+void subscribeSample(int16_t value, unsigned long now);    // push records due
+char* processSubscribeCommand(char *);  // "subscribe: [<stream> <period | change>]"
+char* processUnsubscribeCommand(char *);    // "unsubscribe: [<id> | <stream>]"
+
+#endif
@@ -7,11 +7,11 @@
  */
 
 #include <stdio.h>
- 
-#include <avr/boot.h>
 
 #include "simpleSerial.h"
 #include "tjs_adc.h"
+#include "tjs_hal.h"
+#include "tjs_temp.h"
 
 
 /* CPU on-chip temperature sensor factory calibration data locations.
@@ -43,13 +43,14 @@ void readTempCalibrationData();			// doesn't get anything for this processor
 
 
 
-/* readTemperatureSensor() - read CPU on-chip temperature sensor.
+/* readTemperatureAdc() - read CPU on-chip temperature sensor, as an ADC
+ * value.
  *
  * This function reads the on-chip temperature sensor calibration data,
  * if it has not been read already. 
  */
  
-float readTemperatureSensor(void) {
+static int readTemperatureAdc(void) {
 	
 	int temperature;
 	
@@ -66,11 +67,38 @@ float readTemperatureSensor(void) {
     readAdc(TEMPCHANNEL);               // read temp sensor first time
     initAdc();                          // FIXME: shouldn't have to do every time
     temperature =  readAdc(TEMPCHANNEL);    // read temp sensor second time
+	return temperature;
+}
+
+
+
+/* Constants copied from http://microchipdeveloper.com/8avr:avradc
+ * No explanation provided about their derivation. */
+
+#if CONFIG_FLOAT
+
+/* readTemperatureSensor() - read CPU on-chip temperature sensor, in
+ * degrees C.
+ */
+
+float readTemperatureSensor(void) {
+	return (readTemperatureAdc() - 247.0)/1.22;
+}
+
+#endif
+
+
+
+/* readTemperatureDeci() - read CPU on-chip temperature sensor, in 0.1
+ * degrees C, rounded, without floating point: (adc - 247) / 1.22 * 10 is
+ * (adc - 247) * 500 / 61.
+ */
+
+int16_t readTemperatureDeci(void) {
 
-    /* Constants copied from http://microchipdeveloper.com/8avr:avradc
-     * No explanation provided about their derivation. */
+	int32_t n = (int32_t)(readTemperatureAdc() - 247) * 500;
 
-	return (temperature - 247.0)/1.22;
+	return (int16_t)((n + (n < 0 ? -30 : 30)) / 61);
 }
 
 
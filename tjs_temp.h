@@ -7,4 +7,11 @@
  * Copyright (C) Timothy J. Salo, 2018.
  */
 
+#include <stdint.h>
+
+#include "tjs_config.h"
+
+#if CONFIG_FLOAT
 float readTemperatureSensor(void);       // read on-chip temperature sensor
+#endif
+int16_t readTemperatureDeci(void);      // read it, in 0.1 degrees C (no floating point)
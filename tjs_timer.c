@@ -0,0 +1,141 @@
+/* tjs_timer.c - software timers driven by the millisecond clock.
+ *
+ * Each timer holds its next deadline (the msec clock value at which it
+ * expires).  Periodic timers are rescheduled by adding the period to the
+ * old deadline, not to the current time, so they do not drift when the
+ * main loop is late.  If a timer falls more than one period behind, the
+ * missed expirations are skipped, rather than run back to back.
+ *
+ * Deadlines are compared with wrapping (signed difference) arithmetic, so
+ * the low 32 bits of the msec clock are enough.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdint.h>
+
+#include "tjs_hal.h"
+#include "tjs_msec_clock.h"
+#include "tjs_sched.h"
+#include "tjs_timer.h"
+
+
+typedef struct {
+	timerCallback callback;             // NULL if timer not in use
+	unsigned long expiry;               // next deadline (msec clock)
+	unsigned long period;               // 0 for one-shot
+} softTimer;
+
+static softTimer timers[TIMERS];
+
+volatile unsigned long timerNextExpiry = 0;
+volatile uint8_t timerExpired = 0;
+
+
+#define EXPIRED(now, expiry) ((long)((now) - (expiry)) >= 0)
+
+
+/* scheduleNext - tell the timer 4 ISR about the earliest deadline.
+ */
+
+static void scheduleNext(void) {
+
+	unsigned long now = getMsecClock();
+	unsigned long next = now + 0x7fffffffUL;    // nothing due
+	uint8_t pending = 0;
+	uint8_t i;
+
+	for (i = 0; i < TIMERS; i++) {
+		if (timers[i].callback == NULL) continue;
+		if (EXPIRED(now, timers[i].expiry)) pending = 1;
+		if ((long)(timers[i].expiry - next) < 0) next = timers[i].expiry;
+	}
+
+	unsigned char sreg = SREG;          // save interrupt state
+	cli();
+	timerNextExpiry = next;
+	if (pending) {
+		timerExpired = 1;
+		postEventFromIsr(EVENT_TIMER);  // interrupts are off here
+	}
+	SREG = sreg;
+}
+
+
+
+/* timerStart - start a timer that expires in delay msec, and then every
+ * period msec (or only once, if period is 0).  Returns the timer id, or
+ * -1 if all timers are in use.
+ */
+
+int timerStart(timerCallback callback, unsigned long delay, unsigned long period) {
+
+	uint8_t i;
+
+	for (i = 0; i < TIMERS; i++) {
+		if (timers[i].callback == NULL) {
+			timers[i].expiry = getMsecClock() + delay;
+			timers[i].period = period;
+			timers[i].callback = callback;
+			scheduleNext();
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+
+/* timerStop - stop a timer, freeing its id.
+ */
+
+void timerStop(int id) {
+	if ((id < 0) || (id >= TIMERS)) return;
+	timers[id].callback = NULL;
+	scheduleNext();
+}
+
+
+
+/* timerSetPeriod - change the period of a running timer.  Takes effect
+ * after the next expiration.
+ */
+
+void timerSetPeriod(int id, unsigned long period) {
+	if ((id < 0) || (id >= TIMERS)) return;
+	timers[id].period = period;
+}
+
+
+
+/* runTimers - run the callbacks of all expired timers.
+ * Cheap when nothing has expired: only timerExpired is tested.
+ */
+
+void runTimers(void) {
+
+	uint8_t i;
+
+	if (!timerExpired) return;
+	timerExpired = 0;
+
+	unsigned long now = getMsecClock();
+
+	for (i = 0; i < TIMERS; i++) {
+		softTimer *t = &timers[i];
+		if ((t->callback == NULL) || !EXPIRED(now, t->expiry)) continue;
+
+		timerCallback callback = t->callback;
+		if (t->period != 0) {
+			t->expiry += t->period;     // drift-free reschedule
+			if (EXPIRED(now, t->expiry)) {    // fell behind; skip missed periods
+				t->expiry += ((now - t->expiry) / t->period + 1) * t->period;
+			}
+		} else {
+			t->callback = NULL;         // one-shot
+		}
+		callback();
+	}
+
+	scheduleNext();
+}
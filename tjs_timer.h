@@ -0,0 +1,28 @@
+/* tjs_timer.h - software timers driven by the millisecond clock.
+ *
+ * Timers are one-shot or periodic.  The timer 4 ISR only compares the
+ * millisecond clock with the earliest timer deadline and sets
+ * timerExpired; the callbacks themselves run from runTimers() in the
+ * main loop, with interrupts enabled.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_TIMER_H
+#define TJS_TIMER_H
+
+#include <stdint.h>
+
+#define TIMERS 8                        // max number of software timers
+
+typedef void (*timerCallback)(void);
+
+extern volatile unsigned long timerNextExpiry;    // earliest deadline (checked by timer 4 ISR)
+extern volatile uint8_t timerExpired;   // set by timer 4 ISR when a deadline passes
+
+int timerStart(timerCallback, unsigned long delay, unsigned long period);    // start timer, return id
+void timerStop(int id);                 // stop timer
+void timerSetPeriod(int id, unsigned long period);    // change period of running timer
+void runTimers(void);                   // run callbacks of expired timers
+
+#endif
@@ -0,0 +1,238 @@
+/* tjs_timesync.c - host / device time synchronisation.
+ *
+ * The exchange is two commands (times in usec):
+ *
+ *   host:   "sync: <t1>"                t1 = host time of send
+ *   device: "sync: <t1> <t2> <t3>"      t2 = device time command arrived
+ *                                       t3 = device time of reply
+ *   host:   "sync: <t1> <t2> <t3> <t4>" t4 = host time reply arrived
+ *   device: "sync: <offset> <delay> <drift>"
+ *
+ * From the four times the device computes, as NTP does:
+ *
+ *   offset = ((t2 - t1) + (t3 - t4)) / 2    device clock minus host clock
+ *   delay  = (t4 - t1) - (t3 - t2)          round trip, less device time
+ *
+ * The offset is tracked as offset(t) = offset0 + drift * (t - ref), where
+ * drift is in 2^-24 units (about 0.06 ppm).  Each measurement corrects
+ * both terms by a fraction of the prediction error, so single noisy
+ * measurements do not move the estimate much.
+ *
+ * t2 is the time the command's terminating character was received (the
+ * time its event was posted), not the time it was processed, so that
+ * queueing in the main loop does not count as link delay.
+ *
+ * avr-libc printf() does not handle 64-bit integers, so they are
+ * formatted and parsed here.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tjs_msec_clock.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+#include "tjs_reply.h"
+#include "tjs_sched.h"
+#include "tjs_timesync.h"
+
+#define DRIFT_SHIFT 24                  // drift is in 2^-24 units
+#define GAIN_SHIFT 2                    // correct by 1/4 of the error
+#define MAX_ERROR 1000000LL             // start over if off by more (usec)
+
+static long long offset0;               // device minus host at ref (usec)
+static unsigned long long ref;          // device time of offset0 (usec)
+static long drift;                      // drift, in 2^-DRIFT_SHIFT units
+static unsigned int samples = 0;        // measurements taken
+
+
+/* formatU64 / formatS64 - format 64-bit integers, return end of string.
+ */
+
+static char* formatU64(char *p, unsigned long long n) {
+
+	char digits[21];
+	uint8_t i = 0;
+
+	do {
+		digits[i++] = '0' + (n % 10);
+		n /= 10;
+	} while (n != 0);
+	while (i > 0) *p++ = digits[--i];
+	*p = '\0';
+	return p;
+}
+
+
+static char* formatS64(char *p, long long n) {
+	if (n < 0) {
+		*p++ = '-';
+		return formatU64(p, -(unsigned long long)n);
+	}
+	return formatU64(p, n);
+}
+
+
+/* parseU64 - parse a 64-bit unsigned integer.
+ */
+
+static unsigned long long parseU64(const char *s) {
+	unsigned long long n = 0;
+	while ((*s >= '0') && (*s <= '9')) n = n * 10 + (*s++ - '0');
+	return n;
+}
+
+
+
+/* deviceTimeUsec - device clock (time since msec clock started), in usec.
+ */
+
+unsigned long long deviceTimeUsec(void) {
+	return getTimestamp() * TIMESTAMP_USEC_PER_TICK;
+}
+
+
+int timesyncValid(void) {
+	return samples != 0;
+}
+
+
+
+/* predictOffset - predicted device minus host offset at device time t.
+ */
+
+static long long predictOffset(unsigned long long t) {
+	return offset0 + (((long long)(t - ref) * drift) >> DRIFT_SHIFT);
+}
+
+
+
+/* hostTimeUsec - convert device time to host time.
+ */
+
+long long hostTimeUsec(unsigned long long deviceUsec) {
+	return (long long)deviceUsec - predictOffset(deviceUsec);
+}
+
+
+
+/* updateEstimate - fold one offset measurement, made at device time t,
+ * into the offset and drift estimate.
+ */
+
+static void updateEstimate(long long offset, unsigned long long t) {
+
+	if ((samples != 0) && (llabs(offset - predictOffset(t)) > MAX_ERROR)) {
+		samples = 0;                    // host clock stepped; start over
+	}
+
+	if (samples == 0) {                 // first measurement: take it
+		offset0 = offset;
+		ref = t;
+		drift = 0;
+	} else {
+		long long error = offset - predictOffset(t);
+		long long interval = t - ref;
+		if (interval > 0) {
+			long long correction = (error << DRIFT_SHIFT) / interval;
+			if (samples > 1) correction >>= GAIN_SHIFT;    // second measurement: take it all
+			drift += correction;
+		}
+		offset0 = predictOffset(t) + (error >> GAIN_SHIFT);
+		ref = t;
+	}
+	samples++;
+}
+
+
+
+/* processSyncCommand - process "sync: <t1> [<t2> <t3> <t4>]" command.
+ * See above.
+ * Note: this code is not reentrant.
+ */
+
+char* processSyncCommand(char *command) {
+
+	const uint8_t size = 80;
+	char *string = replySlot(size);
+	char *p = string;
+	char *token[4];
+	uint8_t n;
+
+	for (n = 0; n < 4; n++) {
+		token[n] = nextArg();
+		if (token[n] == NULL) break;
+	}
+
+	if (n == 1) {
+
+		/* First half: return t1, t2, t3. */
+
+		unsigned long long now = getTimestamp();
+		unsigned int age = (unsigned int)now - schedCurrentPostTicks;
+		unsigned long long t2 = (now - age) * TIMESTAMP_USEC_PER_TICK;
+
+		p += strlen(strcpy_P(p, PSTR("sync: ")));
+		p = formatU64(p, parseU64(token[0]));
+		*p++ = ' ';
+		p = formatU64(p, t2);
+		*p++ = ' ';
+		p = formatU64(p, deviceTimeUsec());
+		strcpy_P(p, PSTR("\n"));
+		return string;
+	}
+
+	if (n == 4) {
+
+		/* Second half: fold in the measurement. */
+
+		long long t1 = parseU64(token[0]);
+		long long t2 = parseU64(token[1]);
+		long long t3 = parseU64(token[2]);
+		long long t4 = parseU64(token[3]);
+		long long offset = ((t2 - t1) + (t3 - t4)) / 2;
+		long long delay = (t4 - t1) - (t3 - t2);
+
+		if (delay < 0) return progmemReply(PSTR("nack:\n"));    // inconsistent times
+		updateEstimate(offset, t2 + (t3 - t2) / 2);
+
+		p += strlen(strcpy_P(p, PSTR("sync: ")));
+		p = formatS64(p, offset);
+		*p++ = ' ';
+		p = formatS64(p, delay);
+		snprintf_P(p, size - (p - string), PSTR(" %ld\n"), drift);
+		return string;
+	}
+
+	return progmemReply(PSTR("nack:\n"));
+}
+
+
+
+/* processTimeCommand - process "time:" command.  Responds with:
+ *     "time: <device usec> <host usec> <offset usec> <drift ppb> <samples>"
+ * <host usec> is 0 until a "sync:" exchange has completed.
+ * Note: this code is not reentrant.
+ */
+
+char* processTimeCommand(char *command) {
+
+	const uint8_t size = 90;
+	char *string = replySlot(size);
+	char *p = string;
+	unsigned long long now = deviceTimeUsec();
+
+	p += strlen(strcpy_P(p, PSTR("time: ")));
+	p = formatU64(p, now);
+	*p++ = ' ';
+	p = formatS64(p, timesyncValid() ? hostTimeUsec(now) : 0);
+	*p++ = ' ';
+	p = formatS64(p, timesyncValid() ? predictOffset(now) : 0);
+	snprintf_P(p, size - (p - string), PSTR(" %ld %u\n"),
+	         (long)(((long long)drift * 1000000000LL) >> DRIFT_SHIFT), samples);
+	return string;
+}
@@ -0,0 +1,23 @@
+/* tjs_timesync.h - host / device time synchronisation.
+ *
+ * An NTP-style exchange over any interface lets the device estimate the
+ * offset and drift between its clock and the host's clock, so that
+ * device timestamps can be converted to host time without a round trip
+ * per sample.  All times are in usec.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_TIMESYNC_H
+#define TJS_TIMESYNC_H
+
+#include <stdint.h>
+
+unsigned long long deviceTimeUsec(void);    // device clock, usec
+int timesyncValid(void);                // true once an offset has been measured
+long long hostTimeUsec(unsigned long long deviceUsec);    // convert device time to host time
+
+char* processSyncCommand(char *);       // "sync: <t1> [<t2> <t3> <t4>]"
+char* processTimeCommand(char *);       // "time:"
+
+#endif
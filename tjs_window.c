@@ -0,0 +1,161 @@
+/* tjs_window.c - incremental windowed statistics of sensor samples.
+ *
+ * Welford's method, for each new sample x:
+ *
+ *   n     = n + 1
+ *   delta = x - mean
+ *   mean  = mean + delta / n
+ *   m2    = m2 + delta * (x - mean)
+ *
+ * and the variance is m2 / (n - 1).  Here mean, delta, and m2 carry
+ * WINDOW_MEAN_SHIFT fractional bits, so that the mean does not lose the
+ * fraction of a 0.1 degree step at every update.
+ *
+ * Windows are tumbling: when a window's length has passed, its current
+ * accumulator becomes its "last" result and a new one is started.  Window
+ * starts advance by exactly one length, so windows do not drift.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "tjs_msec_clock.h"
+#include "tjs_parse.h"
+#include "tjs_progmem.h"
+#include "tjs_reply.h"
+#include "tjs_window.h"
+
+
+static window windows[WINDOWS] = {
+	{1000}, {10000}, {60000}            // default lengths: 1, 10, 60 seconds
+};
+
+
+static void clearStats(windowStats *stats) {
+	memset(stats, 0, sizeof(*stats));
+}
+
+
+
+/* windowInit - clear all windows; start them at now.
+ */
+
+void windowInit(unsigned long now) {
+
+	uint8_t i;
+
+	for (i = 0; i < WINDOWS; i++) {
+		windows[i].start = now;
+		clearStats(&windows[i].current);
+		clearStats(&windows[i].last);
+	}
+}
+
+
+
+/* windowAdd - add a sample to every window, closing windows that have
+ * ended first.
+ */
+
+void windowAdd(int16_t value, unsigned long now) {
+
+	uint8_t i;
+	int32_t x = (int32_t)value << WINDOW_MEAN_SHIFT;
+
+	for (i = 0; i < WINDOWS; i++) {
+		window *w = &windows[i];
+		windowStats *s = &w->current;
+
+		if (now - w->start >= w->length) {    // window ended
+			w->last = *s;
+			clearStats(s);
+			w->start += w->length;
+			if (now - w->start >= w->length) w->start = now;    // fell behind; resync
+		}
+
+		if (s->count == UINT16_MAX) continue;    // saturated
+		if (s->count == 0) {
+			s->min = s->max = value;
+		} else {
+			if (value < s->min) s->min = value;
+			if (value > s->max) s->max = value;
+		}
+
+		s->count++;
+		int32_t delta = x - s->mean;
+		s->mean += delta / s->count;
+		s->m2 += ((int64_t)delta * (x - s->mean)) >> WINDOW_MEAN_SHIFT;
+	}
+}
+
+
+
+/* windowSetLength - set the length of window n (msec).  Restarts that
+ * window at now.  Returns 0 on success, -1 on a bad window or length.
+ */
+
+int windowSetLength(uint8_t n, unsigned long length, unsigned long now) {
+
+	if ((n >= WINDOWS) || (length == 0)) return -1;
+	windows[n].length = length;
+	windows[n].start = now;
+	clearStats(&windows[n].current);
+	clearStats(&windows[n].last);
+	return 0;
+}
+
+
+const window* windowAt(uint8_t n) {
+	if (n >= WINDOWS) return NULL;
+	return &windows[n];
+}
+
+
+
+/* processWindowCommand - process "agg: [<window> [<msec>]]" command.
+ *
+ * "agg:" returns the window lengths: "agg: <msec> <msec> <msec>".
+ * "agg: <n>" returns the last completed result of window n:
+ *     "agg: <msec> <count> <min> <max> <mean> <variance>"
+ * where min and max are in 0.1 degrees C, mean is in 0.01 degrees C, and
+ * variance is in (0.01 degrees C)^2.
+ * "agg: <n> <msec>" sets the length of window n.
+ *
+ * Note: this code is not reentrant.
+ */
+
+char* processWindowCommand(char *command) {
+
+	const uint8_t size = 80;
+	char *string = replySlot(size);
+	char* token = nextArg();             // grab possible <window>
+
+	if (token == NULL) {
+		snprintf_P(string, size, PSTR("agg: %lu %lu %lu\n"),
+		         windows[0].length, windows[1].length, windows[2].length);
+		return string;
+	}
+
+	uint8_t n = atoi(token);
+	token = nextArg();                   // grab possible <msec>
+	if (token != NULL) {
+		if (windowSetLength(n, atol(token), getMsecClock()) < 0) return progmemReply(PSTR("nack:\n"));
+	}
+
+	const window *w = windowAt(n);
+	if (w == NULL) return progmemReply(PSTR("nack:\n"));
+
+	const windowStats *s = &w->last;
+	long mean = (s->mean * 10L) >> WINDOW_MEAN_SHIFT;
+	unsigned long variance = 0;
+	if (s->count > 1) {
+		variance = (unsigned long)((s->m2 * 100) / (s->count - 1) >> WINDOW_MEAN_SHIFT);
+	}
+	snprintf_P(string, size, PSTR("agg: %lu %u %d %d %ld %lu\n"),
+	         w->length, s->count, s->min, s->max, mean, variance);
+	return string;
+}
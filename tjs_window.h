@@ -0,0 +1,43 @@
+/* tjs_window.h - incremental windowed statistics of sensor samples.
+ *
+ * Samples are accumulated over several tumbling windows (by default 1,
+ * 10, and 60 seconds).  For each window, the count, minimum, maximum,
+ * mean, and variance are kept incrementally, using Welford's method in
+ * integer arithmetic, so no samples need to be stored.  A host can fetch
+ * the result of the last completed window with one "agg:" command,
+ * rather than fetching every sample.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#ifndef TJS_WINDOW_H
+#define TJS_WINDOW_H
+
+#include <stdint.h>
+
+#define WINDOWS 3                       // number of windows
+#define WINDOW_MEAN_SHIFT 4             // mean kept with 4 fractional bits
+
+typedef struct {
+	uint16_t count;                     // samples in window
+	int16_t min;                        // minimum sample
+	int16_t max;                        // maximum sample
+	int32_t mean;                       // mean, << WINDOW_MEAN_SHIFT
+	int64_t m2;                         // sum of squared differences, << WINDOW_MEAN_SHIFT
+} windowStats;
+
+typedef struct {
+	unsigned long length;               // window length (msec)
+	unsigned long start;                // msec clock of start of current window
+	windowStats current;                // window being accumulated
+	windowStats last;                   // last completed window
+} window;
+
+void windowInit(unsigned long now);     // clear all windows
+void windowAdd(int16_t value, unsigned long now);    // add a sample to all windows
+int windowSetLength(uint8_t n, unsigned long length, unsigned long now);    // set length of window n, restart it
+const window* windowAt(uint8_t n);      // window n
+
+char* processWindowCommand(char *);     // "agg: [<window> [<msec>]]"
+
+#endif
@@ -0,0 +1,165 @@
+/* deltaBench.c - host benchmark of delta/varint sample compression.
+ *
+ * Encodes a temperature trace with the firmware's tjs_delta.c and
+ * tjs_history.c, checks that it decodes back exactly, and reports the
+ * compression ratio and encode time.
+ *
+ * Usage: deltaBench [<capture file>]
+ *
+ * With no argument, a synthetic trace (slow random walk with ADC noise)
+ * is used.  A capture file is any text file, such as a terminal log;
+ * every "temp: nn.n" found in it is used as a sample.
+ *
+ * Build with "make deltabench".
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "tjs_delta.h"
+#include "tjs_history.h"
+
+#define MAX_SAMPLES 100000
+#define RAW_BYTES_PER_SAMPLE 12         // "temp: nn.n\r\n"
+#define PERIOD 100                      // msec between samples
+
+static int16_t samples[MAX_SAMPLES];
+static uint8_t encoded[MAX_SAMPLES * DELTA_MAX_BYTES];
+
+
+/* syntheticTrace - slow random walk, in 0.1 degrees C, plus +/- 1 LSB of
+ * ADC noise on about a third of the samples.
+ */
+
+static int syntheticTrace(int n) {
+
+	uint32_t lcg = 12345;
+	int level = 250;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		lcg = lcg * 1103515245u + 12345u;
+		uint32_t r = (lcg >> 16) & 0x7fff;
+		if (r % 50 == 0) level += (r & 0x100) ? 1 : -1;    // drift
+		int noise = (r % 3) - 1;
+		samples[i] = level + noise;
+	}
+	return n;
+}
+
+
+/* captureTrace - read "temp: nn.n" values from a text file.
+ */
+
+static int captureTrace(const char *fileName) {
+
+	FILE *f = fopen(fileName, "r");
+	char line[256];
+	int n = 0;
+
+	if (f == NULL) {
+		perror(fileName);
+		exit(2);
+	}
+	while ((n < MAX_SAMPLES) && fgets(line, sizeof(line), f)) {
+		char *p = strstr(line, "temp:");
+		double t;
+		if ((p != NULL) && (sscanf(p + 5, "%lf", &t) == 1)) {
+			samples[n++] = (int16_t)(t * 10.0 + (t < 0 ? -0.5 : 0.5));
+		}
+	}
+	fclose(f);
+	return n;
+}
+
+
+static double nowNsec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+int main(int argc, char **argv) {
+
+	int n = (argc > 1) ? captureTrace(argv[1]) : syntheticTrace(10000);
+	size_t packed = 0;
+	int i;
+
+	if (n < 2) {
+		fprintf(stderr, "deltaBench: need at least 2 samples\n");
+		return 2;
+	}
+
+	/* Stream encoding: one key-frame, then deltas. */
+
+	double t0 = nowNsec();
+#ifdef HAVE_TSC
+	uint64_t c0 = __rdtsc();
+#endif
+	for (i = 1; i < n; i++) {
+		packed += deltaEncode(samples[i-1], samples[i], &encoded[packed]);
+	}
+#ifdef HAVE_TSC
+	uint64_t c1 = __rdtsc();
+#endif
+	double t1 = nowNsec();
+	packed += sizeof(int16_t);          // key-frame
+
+	/* Check that the stream decodes back exactly. */
+
+	int16_t v = samples[0];
+	size_t p = 0;
+	for (i = 1; i < n; i++) {
+		uint8_t len = deltaDecode(v, &encoded[p], DELTA_MAX_BYTES, &v);
+		if ((len == 0) || (v != samples[i])) {
+			fprintf(stderr, "deltaBench: decode mismatch at sample %d\n", i);
+			return 1;
+		}
+		p += len;
+	}
+
+	/* SRAM history ring, as kept on the device. */
+
+	historyInit(PERIOD);
+	for (i = 0; i < n; i++) historyAdd(samples[i], (unsigned long)i * PERIOD);
+	uint16_t seq = historyNextSeq() - historySamples();
+	for (i = n - historySamples(); i < n; i++, seq++) {
+		int16_t h;
+		unsigned long t;
+		if (!historyGet(seq, &h, &t) || (h != samples[i]) ||
+		    (t != (unsigned long)i * PERIOD)) {
+			fprintf(stderr, "deltaBench: history mismatch at sample %d\n", i);
+			return 1;
+		}
+	}
+
+	/* Report. */
+
+	double raw = (double)n * RAW_BYTES_PER_SAMPLE;
+	printf("samples:              %d\n", n);
+	printf("raw text bytes:       %.0f (%d per sample)\n", raw, RAW_BYTES_PER_SAMPLE);
+	printf("stream bytes:         %zu (%.2f per sample, ratio %.1f:1)\n",
+	       packed, (double)packed / n, raw / packed);
+	printf("history held:         %u samples in %u blocks, %u bytes (%.2f per sample)\n",
+	       historySamples(), historyBlockCount(), historyBytes(),
+	       (double)historyBytes() / historySamples());
+	printf("history wire (hex):   %.2f bytes per sample\n",
+	       (2.0 * historyBytes()) / historySamples());
+	printf("encode time:          %.1f ns per sample\n", (t1 - t0) / (n - 1));
+#ifdef HAVE_TSC
+	printf("encode cycles (host): %.1f per sample\n", (double)(c1 - c0) / (n - 1));
+#endif
+	return 0;
+}
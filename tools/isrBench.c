@@ -0,0 +1,416 @@
+/* isrBench.c - cycle-accurate ISR benchmark of the firmware under simavr.
+ *
+ * Loads main.obj into a simulated ATmega32U4 and injects traffic while it
+ * runs: "send: temp" commands on USART1, I2C writes of the same command
+ * to the TWI slave, and SPI bytes.  It reports, as JSON on stdout:
+ *
+ *   - for each interrupt vector: count, and min / mean / max cycles from
+ *     vector entry to RETI, and max latency (cycles from the interrupt
+ *     becoming pending to its vector being taken);
+ *   - the longest stretch with interrupts disabled (I bit clear), both
+ *     overall and outside ISRs (i.e., cli() sections in the main loop);
+ *   - per interface, bytes injected and bytes dropped (USART: refused
+ *     while the receiver was backed up; TWI: not acknowledged in time;
+ *     SPI: overwritten before the ISR read them).
+ *
+ * Usage: isrBench [-s seconds] [-u uart Bps] [-t twi Bps] [-p spi Bps]
+ *                 [-a twi address] main.obj
+ *
+ * Rates are bytes per second (0 disables that interface).  Defaults:
+ * 2 seconds of simulated time, USART at line rate (5760 Bps at 57600
+ * bps), TWI at 100 kHz (about 11000 Bps), SPI 10000 Bps.
+ *
+ * If the simavr core does not model timer 4 (the ATmega32U4 high-speed
+ * timer), the compare match A interrupt is raised every msec by the
+ * benchmark itself, so the msec clock and software timers still run.
+ *
+ * Build with "make bench" (needs simavr and libelf).  Not yet built or
+ * run against simavr, so "make report" and "make variants" leave it out.
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "sim_irq.h"
+#include "sim_interrupts.h"
+#include "sim_cycle_timers.h"
+#include "avr_uart.h"
+#include "avr_twi.h"
+#include "avr_spi.h"
+
+#define MCU "atmega32u4"
+#define F_CPU 16000000UL
+#define VECTORS 64
+#define SPI_STC_VECTOR 24               // SPI_STC_vect_num
+#define TIMER4_COMPA_VECTOR 38          // TIMER4_COMPA_vect_num
+#define TWI_ADDRESS 0x77                // I2C_ADDR in main.c
+
+static const char command[] = "send: temp";
+
+/* ATmega32U4 vector names (avr-libc <avr/iom32u4.h>). */
+
+static const char *vectorNames[VECTORS] = {
+	[1] = "INT0", [2] = "INT1", [3] = "INT2", [4] = "INT3", [7] = "INT6",
+	[9] = "PCINT0", [10] = "USB_GEN", [11] = "USB_COM", [12] = "WDT",
+	[16] = "TIMER1_CAPT", [17] = "TIMER1_COMPA", [18] = "TIMER1_COMPB",
+	[19] = "TIMER1_COMPC", [20] = "TIMER1_OVF", [21] = "TIMER0_COMPA",
+	[22] = "TIMER0_COMPB", [23] = "TIMER0_OVF", [24] = "SPI_STC",
+	[25] = "USART1_RX", [26] = "USART1_UDRE", [27] = "USART1_TX",
+	[28] = "ANALOG_COMP", [29] = "ADC", [30] = "EE_READY",
+	[31] = "TIMER3_CAPT", [32] = "TIMER3_COMPA", [33] = "TIMER3_COMPB",
+	[34] = "TIMER3_COMPC", [35] = "TIMER3_OVF", [36] = "TWI",
+	[37] = "SPM_READY", [38] = "TIMER4_COMPA", [39] = "TIMER4_COMPB",
+	[40] = "TIMER4_COMPD", [41] = "TIMER4_OVF", [42] = "TIMER4_FPF"
+};
+
+/* Per-vector statistics. */
+
+typedef struct {
+	unsigned long count;
+	uint64_t cycles;                    // total entry-to-RETI cycles
+	uint64_t minCycles;
+	uint64_t maxCycles;
+	uint64_t maxLatency;                // pending to entry
+	avr_cycle_count_t pendingAt;        // cycle it became pending
+	int pending;                        // raised, and not yet taken
+	avr_cycle_count_t enteredAt;        // cycle its ISR was entered
+} vectorStats;
+
+static vectorStats stats[VECTORS];
+
+/* Interrupts-disabled windows. */
+
+static uint64_t maxIrqOff;              // longest window, any context
+static uint64_t maxIrqOffMain;          // longest window outside ISRs
+static int isrDepth;                    // ISRs currently running
+
+/* Traffic. */
+
+typedef struct {
+	unsigned long rate;                 // bytes per second (0: off)
+	unsigned long injected;
+	unsigned long dropped;
+	unsigned int next;                  // next byte of command
+} traffic;
+
+static traffic uart = {5760};
+static traffic twi = {11000};
+static traffic spi = {10000};
+
+static avr_t *avr;
+static avr_irq_t *uartIn;
+static avr_irq_t *twiIn;
+static avr_irq_t *spiIn;
+static int uartXoff;                    // USART receive FIFO is full
+static uint8_t twiAddress = TWI_ADDRESS;
+static int twiAcked = 1;                // last TWI byte acknowledged
+static int twiInTransaction;
+static avr_int_vector_t timer4Vector;   // used if the core has no timer 4
+
+
+
+/* Interrupt notifications. */
+
+static void onPending(avr_irq_t *irq, uint32_t value, void *param) {
+
+	avr_int_vector_t *v = param;
+	vectorStats *s;
+
+	if (v->vector >= VECTORS) return;
+	s = &stats[v->vector];
+	if (!value) {
+		s->pending = 0;                 // taken, or cleared
+	} else if (!s->pending) {           // raised again while pending: keep the first time
+		s->pendingAt = avr->cycle;
+		s->pending = 1;
+	}
+}
+
+
+static void onRunning(avr_irq_t *irq, uint32_t value, void *param) {
+
+	avr_int_vector_t *v = param;
+	vectorStats *s;
+
+	if (v->vector >= VECTORS) return;
+	s = &stats[v->vector];
+	if (value) {                        // vector taken
+		uint64_t latency = avr->cycle - s->pendingAt;
+		if (latency > s->maxLatency) s->maxLatency = latency;
+		s->enteredAt = avr->cycle;
+		isrDepth++;
+	} else {                            // RETI
+		uint64_t cycles = avr->cycle - s->enteredAt;
+		s->count++;
+		s->cycles += cycles;
+		if ((s->count == 1) || (cycles < s->minCycles)) s->minCycles = cycles;
+		if (cycles > s->maxCycles) s->maxCycles = cycles;
+		if (isrDepth > 0) isrDepth--;
+	}
+}
+
+
+
+/* USART: flow control and injection. */
+
+static void onUartXon(avr_irq_t *irq, uint32_t value, void *param) {
+	uartXoff = 0;
+}
+
+
+static void onUartXoff(avr_irq_t *irq, uint32_t value, void *param) {
+	uartXoff = 1;
+}
+
+
+static avr_cycle_count_t uartInject(avr_t *avr, avr_cycle_count_t when, void *param) {
+
+	uint8_t ch = (uart.next < sizeof(command) - 1) ? command[uart.next] : '\r';
+
+	uart.next = (uart.next + 1) % sizeof(command);
+	uart.injected++;
+	if (uartXoff) {
+		uart.dropped++;
+	} else {
+		avr_raise_irq(uartIn, ch);
+	}
+	return when + F_CPU / uart.rate;
+}
+
+
+
+/* TWI: the benchmark is the bus master, writing commands. */
+
+static void onTwiOutput(avr_irq_t *irq, uint32_t value, void *param) {
+
+	avr_twi_msg_irq_t m;
+
+	m.u.v = value;
+	if (m.u.twi.msg & TWI_COND_ACK) twiAcked = 1;
+}
+
+
+static avr_cycle_count_t twiInject(avr_t *avr, avr_cycle_count_t when, void *param) {
+
+	if (!twiAcked) {                    // slave still busy with last byte
+		twi.dropped++;
+		avr_raise_irq(twiIn, avr_twi_irq_msg(TWI_COND_STOP, twiAddress, 0));
+		twiInTransaction = 0;
+		twiAcked = 1;
+		return when + F_CPU / twi.rate;
+	}
+
+	twiAcked = 0;
+	if (!twiInTransaction) {
+		avr_raise_irq(twiIn, avr_twi_irq_msg(TWI_COND_START | TWI_COND_ADDR,
+		                                     twiAddress << 1, 0));
+		twiInTransaction = 1;
+		twi.next = 0;
+	} else if (twi.next < sizeof(command)) {
+		uint8_t ch = (twi.next < sizeof(command) - 1) ? command[twi.next] : '\n';
+		avr_raise_irq(twiIn, avr_twi_irq_msg(TWI_COND_WRITE, twiAddress << 1, ch));
+		twi.next++;
+		twi.injected++;
+	} else {
+		avr_raise_irq(twiIn, avr_twi_irq_msg(TWI_COND_STOP, twiAddress << 1, 0));
+		twiInTransaction = 0;
+		twiAcked = 1;
+	}
+	return when + F_CPU / twi.rate;
+}
+
+
+
+/* SPI: the benchmark is the master, sending commands.  A byte sent while
+ * SPI_STC is still pending overwrites the one the ISR has not read yet.
+ */
+
+static avr_cycle_count_t spiInject(avr_t *avr, avr_cycle_count_t when, void *param) {
+
+	uint8_t ch = (spi.next < sizeof(command) - 1) ? command[spi.next] : '\n';
+
+	spi.next = (spi.next + 1) % sizeof(command);
+	spi.injected++;
+	if (stats[SPI_STC_VECTOR].pending) spi.dropped++;
+	avr_raise_irq(spiIn, ch);
+	return when + F_CPU / spi.rate;
+}
+
+
+
+/* Timer 4 stand-in: compare match A every msec. */
+
+static avr_cycle_count_t timer4Tick(avr_t *avr, avr_cycle_count_t when, void *param) {
+	avr_raise_interrupt(avr, &timer4Vector);
+	return when + F_CPU / 1000;
+}
+
+
+
+/* printJson - print the results.
+ */
+
+static void printTraffic(const char *name, traffic *t, int last) {
+	printf("    \"%s\": {\"rate\": %lu, \"injected\": %lu, \"dropped\": %lu}%s\n",
+	       name, t->rate, t->injected, t->dropped, last ? "" : ",");
+}
+
+
+static void printJson(double seconds) {
+
+	int v;
+	int first = 1;
+
+	printf("{\n");
+	printf("  \"mcu\": \"%s\",\n", MCU);
+	printf("  \"f_cpu\": %lu,\n", F_CPU);
+	printf("  \"seconds\": %.3f,\n", seconds);
+	printf("  \"cycles\": %llu,\n", (unsigned long long)avr->cycle);
+	printf("  \"isr\": {\n");
+	for (v = 1; v < VECTORS; v++) {
+		vectorStats *s = &stats[v];
+		if (s->count == 0) continue;
+		printf("%s    \"%s\": {\"vector\": %d, \"count\": %lu, "
+		       "\"min_cycles\": %llu, \"mean_cycles\": %.1f, \"max_cycles\": %llu, "
+		       "\"max_latency_cycles\": %llu}",
+		       first ? "" : ",\n", vectorNames[v] ? vectorNames[v] : "unknown",
+		       v, s->count, (unsigned long long)s->minCycles,
+		       (double)s->cycles / s->count, (unsigned long long)s->maxCycles,
+		       (unsigned long long)s->maxLatency);
+		first = 0;
+	}
+	printf("\n  },\n");
+	printf("  \"irq_off_max_cycles\": %llu,\n", (unsigned long long)maxIrqOff);
+	printf("  \"irq_off_max_cycles_main\": %llu,\n", (unsigned long long)maxIrqOffMain);
+	printf("  \"traffic\": {\n");
+	printTraffic("uart", &uart, 0);
+	printTraffic("twi", &twi, 0);
+	printTraffic("spi", &spi, 1);
+	printf("  }\n");
+	printf("}\n");
+}
+
+
+
+int main(int argc, char **argv) {
+
+	elf_firmware_t firmware;
+	double seconds = 2.0;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "s:u:t:p:a:")) != -1) {
+		switch (opt) {
+		case 's': seconds = atof(optarg); break;
+		case 'u': uart.rate = strtoul(optarg, NULL, 0); break;
+		case 't': twi.rate = strtoul(optarg, NULL, 0); break;
+		case 'p': spi.rate = strtoul(optarg, NULL, 0); break;
+		case 'a': twiAddress = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: isrBench [-s seconds] [-u uart Bps] "
+			        "[-t twi Bps] [-p spi Bps] [-a twi address] main.obj\n");
+			return 2;
+		}
+	}
+	if (optind >= argc) {
+		fprintf(stderr, "isrBench: no firmware (main.obj) given\n");
+		return 2;
+	}
+
+	/* Load the firmware. */
+
+	memset(&firmware, 0, sizeof(firmware));
+	if (elf_read_firmware(argv[optind], &firmware) != 0) {
+		fprintf(stderr, "isrBench: cannot read %s\n", argv[optind]);
+		return 1;
+	}
+	strcpy(firmware.mmcu, MCU);
+	firmware.frequency = F_CPU;
+
+	avr = avr_make_mcu_by_name(firmware.mmcu);
+	if (avr == NULL) {
+		fprintf(stderr, "isrBench: simavr has no %s core\n", MCU);
+		return 1;
+	}
+	avr_init(avr);
+	avr->log = LOG_NONE;
+	avr_load_firmware(avr, &firmware);
+
+	/* Watch every interrupt vector. */
+
+	if (avr->interrupts.vector_count <= TIMER4_COMPA_VECTOR ||
+	    avr->interrupts.vector[TIMER4_COMPA_VECTOR] == NULL) {
+		timer4Vector.vector = TIMER4_COMPA_VECTOR;
+		avr_register_vector(avr, &timer4Vector);
+		avr_cycle_timer_register(avr, F_CPU / 1000, timer4Tick, NULL);
+	}
+	for (i = 0; i < avr->interrupts.vector_count; i++) {
+		avr_int_vector_t *v = avr->interrupts.vector[i];
+		if (v == NULL) continue;
+		avr_irq_register_notify(&v->irq[AVR_INT_IRQ_PENDING], onPending, v);
+		avr_irq_register_notify(&v->irq[AVR_INT_IRQ_RUNNING], onRunning, v);
+	}
+
+	/* Attach the traffic sources. */
+
+	uint32_t flags = 0;
+	avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('1'), &flags);
+	flags &= ~AVR_UART_FLAG_STDIO;      // keep the firmware's output off stdout
+	avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('1'), &flags);
+	uartIn = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_INPUT);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'),
+	                        UART_IRQ_OUT_XON), onUartXon, NULL);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'),
+	                        UART_IRQ_OUT_XOFF), onUartXoff, NULL);
+
+	twiIn = avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0),
+	                        TWI_IRQ_OUTPUT), onTwiOutput, NULL);
+
+	spiIn = avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_INPUT);
+
+	/* Traffic starts after the boot banner (2 seconds in). */
+
+	avr_cycle_count_t start = 2 * F_CPU;
+	if (uart.rate) avr_cycle_timer_register(avr, start, uartInject, NULL);
+	if (twi.rate) avr_cycle_timer_register(avr, start, twiInject, NULL);
+	if (spi.rate) avr_cycle_timer_register(avr, start, spiInject, NULL);
+
+	/* Run, one instruction at a time, timing interrupts-disabled windows. */
+
+	avr_cycle_count_t end = start + (avr_cycle_count_t)(seconds * F_CPU);
+	avr_cycle_count_t offAt = 0;
+	int offInIsr = 0;
+	int wasOn = 0;
+
+	while (avr->cycle < end) {
+		int state = avr_run(avr);
+		if ((state == cpu_Done) || (state == cpu_Crashed)) {
+			fprintf(stderr, "isrBench: firmware stopped (state %d) at cycle %llu\n",
+			        state, (unsigned long long)avr->cycle);
+			return 1;
+		}
+		int on = avr->sreg[S_I];
+		if (on == wasOn) continue;
+		if (!on) {
+			offAt = avr->cycle;
+			offInIsr = (isrDepth > 0);
+		} else if (avr->cycle >= start) {
+			uint64_t window = avr->cycle - offAt;
+			if (window > maxIrqOff) maxIrqOff = window;
+			if (!offInIsr && (window > maxIrqOffMain)) maxIrqOffMain = window;
+		}
+		wasOn = on;
+	}
+
+	printJson(seconds);
+	return 0;
+}
@@ -0,0 +1,426 @@
+/* loadGen.c - load generator for the async (USART) command interface.
+ *
+ * Sends a stream of pipelined commands ("hello: <seq>", "send: temp" and
+ * "p on") to the firmware at a configurable rate, matches the replies,
+ * and reports round-trip latency percentiles, throughput, and lost and
+ * garbled replies.  Use it to check whether changes to uart_putchar() or
+ * ISR(USART1_RX_vect) help.
+ *
+ * Usage: loadGen [options] <serial device>
+ *        loadGen [options] -e <program> [<args>]
+ *
+ *   -r <rate>      commands per second (default 20; 0 = as fast as the
+ *                  window allows)
+ *   -n <count>     commands to send (default 500)
+ *   -w <window>    most commands outstanding at once (default 4)
+ *   -m <mix>       commands to rotate through, from "hello", "send" and
+ *                  "p" (default "hello,send,p")
+ *   -t <msec>      reply timeout; later replies count as lost (default 1000)
+ *   -d <msec>      wait before the first command, so the banner and boot
+ *                  blink are out of the way (default 2500)
+ *   -e             run <program> (e.g., ./host/tjsHost) on a new pty, with
+ *                  TJS_LINE_DELAY=0 unless it is already set
+ *
+ * <serial device> is a tty: the board itself (57600 bps), or the pty of a
+ * simulator bridge such as simavr's uart_pty or socat.
+ *
+ * The firmware echoes each command it accepts as "rx: <command>", and
+ * prints the reply on the next line.  A command is lost if no echo and
+ * reply arrives before the timeout, or if a later command is echoed
+ * first; an echo that matches no outstanding command (e.g., two commands
+ * run together) or a wrong reply is garbled.  Other lines (periodic
+ * "temp:" reports, debug output) are ignored.
+ *
+ * Build with "make loadgen".
+ *
+ * Copyright (C) Timothy J. Salo, 2019.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MAX_WINDOW 64
+#define MAX_COMMANDS 100000
+#define LINE_LENGTH 256
+
+enum kind { HELLO, SEND, P };
+
+/* An outstanding command. */
+
+typedef struct {
+	unsigned long seq;
+	enum kind kind;
+	char text[32];                      // command, as echoed
+	double sentAt;                      // msec
+} request;
+
+static request window[MAX_WINDOW];      // outstanding, oldest first
+static int outstanding;
+static request current;                 // echoed, reply expected next
+static int haveCurrent;
+
+static double latency[MAX_COMMANDS];    // round-trip times, msec
+static unsigned long replies, lost, garbled, otherLines;
+static unsigned long bytesOut, bytesIn;
+
+
+
+/* nowMsec - monotonic time, in msec.
+ */
+
+static double nowMsec(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+
+
+/* openDevice - open a serial device, raw, at 57600 bps.
+ */
+
+static int openDevice(const char *path) {
+
+	struct termios t;
+	int fd = open(path, O_RDWR | O_NOCTTY);
+
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	if (tcgetattr(fd, &t) == 0) {
+		cfmakeraw(&t);
+		cfsetspeed(&t, B57600);
+		tcsetattr(fd, TCSANOW, &t);
+	}
+	return fd;
+}
+
+
+
+/* spawnOnPty - run a program with a new pty as its stdin and stdout.
+ * Returns the master side.
+ */
+
+static int spawnOnPty(char **argv, pid_t *pid) {
+
+	struct termios t;
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+		perror("loadGen: pty");
+		exit(1);
+	}
+	char *slaveName = ptsname(master);
+
+	*pid = fork();
+	if (*pid < 0) {
+		perror("loadGen: fork");
+		exit(1);
+	}
+	if (*pid == 0) {
+		setsid();
+		int slave = open(slaveName, O_RDWR);
+		if (slave < 0) _exit(127);
+		if (tcgetattr(slave, &t) == 0) {
+			cfmakeraw(&t);              // no echo, no line editing
+			tcsetattr(slave, TCSANOW, &t);
+		}
+		dup2(slave, 0);
+		dup2(slave, 1);
+		close(slave);
+		close(master);
+		setenv("TJS_LINE_DELAY", "0", 0);
+		execvp(argv[0], argv);
+		perror(argv[0]);
+		_exit(127);
+	}
+	return master;
+}
+
+
+
+/* writeAll - write a whole buffer.
+ */
+
+static void writeAll(int fd, const char *buffer, size_t length) {
+
+	while (length > 0) {
+		ssize_t n = write(fd, buffer, length);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			perror("loadGen: write");
+			exit(1);
+		}
+		buffer += n;
+		length -= n;
+		bytesOut += n;
+	}
+}
+
+
+
+/* dropOldest - remove the first n outstanding commands.
+ */
+
+static void dropOldest(int n) {
+
+	memmove(&window[0], &window[n], (outstanding - n) * sizeof(window[0]));
+	outstanding -= n;
+}
+
+
+
+/* replyMatches - check a reply line against the command it answers.
+ */
+
+static int replyMatches(const request *r, const char *line) {
+
+	char expected[40];
+
+	switch (r->kind) {
+	case HELLO:
+		snprintf(expected, sizeof(expected), "ack: %lu", r->seq);
+		return strcmp(line, expected) == 0;
+	case SEND:
+		return (strncmp(line, "temp: ", 6) == 0) || (strcmp(line, "same:") == 0);
+	case P:
+		return strstr(line, "Detailed info printing") != NULL;
+	}
+	return 0;
+}
+
+
+
+/* processLine - account for one line from the firmware.
+ */
+
+static void processLine(const char *line, double now) {
+
+	int i;
+
+	if (strncmp(line, "rx: ", 4) == 0) {
+		if (haveCurrent) lost++;        // previous command never answered
+		haveCurrent = 0;
+		for (i = 0; i < outstanding; i++) {
+			if (strcmp(window[i].text, &line[4]) == 0) break;
+		}
+		if (i == outstanding) {
+			garbled++;
+			return;
+		}
+		lost += i;                      // overtaken, so never accepted
+		current = window[i];
+		haveCurrent = 1;
+		dropOldest(i + 1);
+		return;
+	}
+
+	if (!haveCurrent) {
+		otherLines++;
+		return;
+	}
+	haveCurrent = 0;
+	if (!replyMatches(&current, line)) {
+		garbled++;
+		return;
+	}
+	if (replies < MAX_COMMANDS) latency[replies] = now - current.sentAt;
+	replies++;
+}
+
+
+
+/* compareDouble - qsort() comparison.
+ */
+
+static int compareDouble(const void *a, const void *b) {
+
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+
+
+/* percentile - the p'th percentile of the sorted latencies.
+ */
+
+static double percentile(unsigned long n, double p) {
+
+	if (n == 0) return 0.0;
+	unsigned long i = (unsigned long)(p / 100.0 * (n - 1) + 0.5);
+	return latency[i];
+}
+
+
+
+int main(int argc, char **argv) {
+
+	double rate = 20.0;
+	unsigned long count = 500;
+	int windowSize = 4;
+	char defaultMix[] = "hello,send,p";
+	char *mix = defaultMix;
+	double timeout = 1000.0;
+	double settle = 2500.0;
+	int spawn = 0;
+	pid_t child = 0;
+	enum kind kinds[8];
+	int nKinds = 0;
+	int opt;
+	int fd;
+
+	while ((opt = getopt(argc, argv, "+r:n:w:m:t:d:e")) != -1) {
+		switch (opt) {
+		case 'r': rate = atof(optarg); break;
+		case 'n': count = strtoul(optarg, NULL, 0); break;
+		case 'w': windowSize = atoi(optarg); break;
+		case 'm': mix = optarg; break;
+		case 't': timeout = atof(optarg); break;
+		case 'd': settle = atof(optarg); break;
+		case 'e': spawn = 1; break;
+		default:
+			fprintf(stderr, "usage: loadGen [-r rate] [-n count] [-w window] "
+			        "[-m hello,send,p] [-t msec] [-d msec] "
+			        "(<device> | -e <program> [<args>])\n");
+			return 2;
+		}
+	}
+	if (optind >= argc) {
+		fprintf(stderr, "loadGen: no device or program given\n");
+		return 2;
+	}
+	if (windowSize < 1) windowSize = 1;
+	if (windowSize > MAX_WINDOW) windowSize = MAX_WINDOW;
+	if (count > MAX_COMMANDS) count = MAX_COMMANDS;
+
+	for (char *name = strtok(mix, ","); name && (nKinds < 8); name = strtok(NULL, ",")) {
+		if (strcmp(name, "hello") == 0) kinds[nKinds++] = HELLO;
+		else if (strcmp(name, "send") == 0) kinds[nKinds++] = SEND;
+		else if (strcmp(name, "p") == 0) kinds[nKinds++] = P;
+		else {
+			fprintf(stderr, "loadGen: unknown command \"%s\" in mix\n", name);
+			return 2;
+		}
+	}
+	if (nKinds == 0) kinds[nKinds++] = HELLO;
+
+	signal(SIGPIPE, SIG_IGN);
+	fd = spawn ? spawnOnPty(&argv[optind], &child) : openDevice(argv[optind]);
+
+	char line[LINE_LENGTH];
+	size_t lineLength = 0;
+	unsigned long sent = 0;
+	double start = nowMsec() + settle;  // first command
+	double nextSend = start;
+	double lastReply = start;
+	double interval = (rate > 0.0) ? 1000.0 / rate : 0.0;
+	int eof = 0;
+
+	while (!eof) {
+		double now = nowMsec();
+
+		/* Send while the schedule and the window allow. */
+
+		while ((now >= start) && (sent < count) && (now >= nextSend) &&
+		       (outstanding < windowSize)) {
+			request *r = &window[outstanding++];
+			char buffer[40];
+			r->seq = sent;
+			r->kind = kinds[sent % nKinds];
+			switch (r->kind) {
+			case HELLO: snprintf(r->text, sizeof(r->text), "hello: %lu", r->seq); break;
+			case SEND: strcpy(r->text, "send: temp"); break;
+			case P: strcpy(r->text, "p on"); break;
+			}
+			r->sentAt = now;
+			snprintf(buffer, sizeof(buffer), "%s\r", r->text);
+			writeAll(fd, buffer, strlen(buffer));
+			sent++;
+			nextSend += interval;
+			if (nextSend < now - 1000.0) nextSend = now;    // don't burst after a stall
+		}
+
+		/* Time out the oldest commands. */
+
+		while ((outstanding > 0) && (now - window[0].sentAt > timeout)) {
+			lost++;
+			dropOldest(1);
+		}
+		if (haveCurrent && (now - current.sentAt > timeout)) {
+			lost++;
+			haveCurrent = 0;
+		}
+		if ((sent == count) && (outstanding == 0) && !haveCurrent) break;
+
+		/* Read replies, a line at a time. */
+
+		struct pollfd p = {fd, POLLIN, 0};
+		int wait = (now < start) ? (int)(start - now) : 1;
+		if (poll(&p, 1, wait) <= 0) continue;
+
+		char buffer[512];
+		ssize_t n = read(fd, buffer, sizeof(buffer));
+		if (n <= 0) {
+			if ((n < 0) && (errno == EINTR)) continue;
+			eof = 1;                    // program exited, or device gone
+			break;
+		}
+		bytesIn += n;
+		now = nowMsec();
+		for (ssize_t i = 0; i < n; i++) {
+			char ch = buffer[i];
+			if (ch == '\r') continue;
+			if (ch != '\n') {
+				if (lineLength < sizeof(line) - 1) line[lineLength++] = ch;
+				continue;
+			}
+			line[lineLength] = '\0';
+			lineLength = 0;
+			if (now < start) continue;  // banner
+			unsigned long before = replies;
+			processLine(line, now);
+			if (replies != before) lastReply = now;
+		}
+	}
+	lost += outstanding;                // still outstanding at end of input
+
+	if (child > 0) {
+		kill(child, SIGTERM);
+		waitpid(child, NULL, 0);
+	}
+
+	/* Report. */
+
+	unsigned long n = (replies < MAX_COMMANDS) ? replies : MAX_COMMANDS;
+	double elapsed = (lastReply - start) / 1000.0;
+	qsort(latency, n, sizeof(latency[0]), compareDouble);
+
+	printf("commands sent:        %lu (window %d, %.1f per sec requested)\n",
+	       sent, windowSize, rate);
+	printf("replies:              %lu\n", replies);
+	printf("lost:                 %lu\n", lost);
+	printf("garbled:              %lu\n", garbled);
+	printf("other lines:          %lu\n", otherLines);
+	printf("throughput:           %.1f replies per sec, %.0f bytes per sec in\n",
+	       (elapsed > 0.0) ? replies / elapsed : 0.0,
+	       (elapsed > 0.0) ? bytesIn / elapsed : 0.0);
+	printf("latency (msec):       p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+	       percentile(n, 50), percentile(n, 90), percentile(n, 99),
+	       n ? latency[n - 1] : 0.0);
+	return (lost || garbled) ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+# sramReport.awk - report static SRAM use, per symbol, from "avr-nm -S".
+#
+# Usage: avr-nm -S --size-sort -r main.obj | awk -v sram=2560 -f tools/sramReport.awk
+#
+# Lists every .data (d/D) and .bss (b/B) symbol, largest first, then the
+# totals and the SRAM left for the stack.  Run "mem:" on the board to see
+# how much of that the stack has actually used.
+
+function hex(s,    i, n) {
+	n = 0
+	s = tolower(s)
+	for (i = 1; i <= length(s); i++) n = n * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+	return n
+}
+
+BEGIN {
+	if (sram == "") sram = 2560
+	printf("%6s  %-5s %s\n", "bytes", "sect", "symbol")
+}
+
+NF == 4 && $3 ~ /^[dDbB]$/ {
+	n = hex($2)
+	sect = ($3 ~ /[dD]/) ? ".data" : ".bss"
+	if (sect == ".data") data += n; else bss += n
+	printf("%6d  %-5s %s\n", n, sect, $4)
+}
+
+END {
+	printf("\n")
+	printf("%6d  .data\n", data)
+	printf("%6d  .bss\n", bss)
+	printf("%6d  static total\n", data + bss)
+	printf("%6d  left for stack (of %d)\n", sram - data - bss, sram)
+}